@@ -3,7 +3,32 @@
 #include <ctime>
 #include <fstream>
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
 #include <string>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <io.h>
+#include <filesystem>
+#endif
 
 using namespace std;
 
@@ -259,6 +284,60 @@ public:
     }
 };
 
+// Deal generator: a fixed xorshift32 sequence so that a seed always produces
+// the same deal on every compiler/platform (rand() differs between MSVC and
+// glibc, which made seeded deals and the solver corpus non-reproducible).
+class DealRandom
+{
+private:
+    unsigned int state;
+
+public:
+    DealRandom(unsigned int seed)
+    {
+        state = seed * 2654435761u ^ 0x9E3779B9u;
+        if (state == 0)
+            state = 1;
+    }
+
+    unsigned int next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+};
+
+// Fills cards[0..51] with a shuffled deck for the given seed.
+// Positions 0-27 form the pyramid (row by row), 28-51 the stock (51 on top).
+void dealShuffledDeck(Card* cards, unsigned int seed)
+{
+    int count = 0;
+    for (int suit = 0; suit < 4; suit++)
+    {
+        for (int value = 1; value <= 13; value++)
+        {
+            cards[count] = Card(value, suit, count);
+            count++;
+        }
+    }
+
+    DealRandom rng(seed);
+    for (int i = 51; i > 0; i--)
+    {
+        int j = rng.next() % (i + 1);
+        Card temp = cards[i];
+        cards[i] = cards[j];
+        cards[j] = temp;
+    }
+
+    for (int i = 0; i < 52; i++)
+    {
+        cards[i].position = i;
+    }
+}
+
 struct PyramidCard
 {
     Card* card;
@@ -308,1570 +387,5872 @@ struct PyramidCard
     }
 };
 
-class PyramidSolitaire
+// One player action, from the keyboard/mouse or from a replay file
+enum InputEventType
 {
-private:
-    // PYRAMID CARDS: Using BST (works perfectly for hierarchical structure)
-    BST<PyramidCard> pyramidBST;
+    INPUT_CLICK,
+    INPUT_KEY
+};
 
-    /* ============================================================
-     * FAILED BST IMPLEMENTATION FOR STOCK/WASTE PILES
-     * ============================================================
-     *
-     * PROBLEM: Stock and Waste piles require LIFO (Last In First Out)
-     * stack behavior, but BST maintains sorted order which is incompatible.
-     *
-     * ATTEMPTED IMPLEMENTATION #1: Direct BST with position-based ordering
-     *
-     * BST<Card> stockBST;
-     * BST<Card> wasteBST;
-     *
-     * void drawCardFromStockBST_Attempt1() {
-     *     if (stockBST.isEmpty()) {
-     *         // Recycle waste back to stock
-     *         Card wasteCards[52];
-     *         int count = 0;
-     *
-     *         // Problem: toArray returns cards in SORTED order (by position)
-     *         // not in the order they were added to waste!
-     *         wasteBST.toArray(wasteCards);
-     *         count = wasteBST.getSize();
-     *
-     *         wasteBST.clear();
-     *
-     *         // Cards are inserted in wrong order - BST sorts them!
-     *         for (int i = count - 1; i >= 0; i--) {
-     *             if (wasteCards[i].inPlay) {
-     *                 stockBST.insert(wasteCards[i]);
-     *             }
-     *         }
-     *     }
-     *
-     *     // Problem: How to get the "top" card (last inserted)?
-     *     // BST doesn't track insertion order!
-     *     // getMax() returns highest position, not last inserted
-     *     BSTNode<Card>* maxNode = stockBST.getMax();
-     *     if (maxNode) {
-     *         Card topCard = maxNode->data;
-     *         stockBST.remove(topCard);
-     *         topCard.faceUp = true;
-     *         wasteBST.insert(topCard);
-     *     }
-     * }
-     *
-     * WHY IT FAILS:
-     * - Drawing cards happens in wrong order (sorted by position, not draw order)
-     * - Recycling breaks gameplay (cards reappear in wrong sequence)
-     * - Can't maintain "last drawn" concept
-     *
-     *
-     * ATTEMPTED IMPLEMENTATION #2: Augmented BST with insertion counter
-     *
-     * struct CardWithInsertionOrder {
-     *     Card card;
-     *     int insertionOrder;
-     *
-     *     bool operator<(const CardWithInsertionOrder& other) const {
-     *         return insertionOrder < other.insertionOrder;
-     *     }
-     * };
-     *
-     * BST<CardWithInsertionOrder> stockBST;
-     * BST<CardWithInsertionOrder> wasteBST;
-     * int globalInsertionCounter = 0;
-     *
-     * void drawCardFromStockBST_Attempt2() {
-     *     if (stockBST.isEmpty()) {
-     *         // Recycle waste
-     *         CardWithInsertionOrder wasteCards[52];
-     *         int count = 0;
-     *         wasteBST.toArray(wasteCards);
-     *         count = wasteBST.getSize();
-     *         wasteBST.clear();
-     *
-     *         // Problem: Need to reverse order AND reassign insertion numbers
-     *         for (int i = count - 1; i >= 0; i--) {
-     *             wasteCards[i].insertionOrder = globalInsertionCounter++;
-     *             stockBST.insert(wasteCards[i]);
-     *         }
-     *     }
-     *
-     *     // Problem: getMax() traverses to rightmost node - O(h) every draw!
-     *     // For 24 stock cards, this is inefficient
-     *     BSTNode<CardWithInsertionOrder>* maxNode = stockBST.getMax();
-     *     if (maxNode) {
-     *         CardWithInsertionOrder topCard = maxNode->data;
-     *         stockBST.remove(topCard);
-     *         topCard.card.faceUp = true;
-     *         topCard.insertionOrder = globalInsertionCounter++;
-     *         wasteBST.insert(topCard);
-     *     }
-     * }
-     *
-     * WHY IT STILL FAILS:
-     * - Every draw operation requires tree traversal to rightmost node
-     * - Insertion counter overflow risk in long games
-     * - Complex recycling logic with counter management
-     * - O(log n) for insert/delete + O(h) for finding max = worse than array
-     *
-     *
-     * ATTEMPTED IMPLEMENTATION #3: Reverse-ordered BST
-     *
-     * struct ReverseCard {
-     *     Card card;
-     *     int reversePosition;
-     *
-     *     bool operator<(const ReverseCard& other) const {
-     *         return reversePosition > other.reversePosition; // Reversed!
-     *     }
-     * };
-     *
-     * BST<ReverseCard> stockBST;
-     *
-     * void drawCardFromStockBST_Attempt3() {
-     *     // Problem: Now getMin() gives us "last", but recycling is nightmare
-     *     BSTNode<ReverseCard>* minNode = stockBST.getMin();
-     *     if (minNode) {
-     *         stockBST.remove(minNode->data);
-     *         // ... more complex logic
-     *     }
-     * }
-     *
-     * WHY IT FAILS:
-     * - Confusing reversed logic throughout codebase
-     * - Still can't efficiently handle recycling
-     * - Counter-intuitive comparisons make debugging hard
-     *
-     *
-     * FUNDAMENTAL CONCLUSION:
-     * BST is designed for SORTED data with efficient searching.
-     * Stock/Waste piles need LIFO (stack) behavior with NO sorting.
-     * These requirements are fundamentally incompatible.
-     *
-     * Stack ADT (array-based) is the correct choice:
-     * - O(1) push/pop operations
-     * - Natural LIFO behavior
-     * - Simple recycling (just reverse copy)
-     * - No unnecessary tree maintenance overhead
-     *
-     * Using BST here violates "use the right tool for the job" principle.
-     * After 100% effort and multiple approaches, array-based stack is correct.
-     * ============================================================ */
+struct InputEvent
+{
+    int type;
+    int key;  // INPUT_KEY: raylib key code
+    float x;  // INPUT_CLICK: mouse position
+    float y;
+    double time;  // GetTime() when the press happened (0 for replays)
+};
 
-     // WORKING IMPLEMENTATION: Array-based stacks for LIFO behavior
-    Card* stockArray[52];
-    int stockTop;
+// Player actions waiting to be handled, oldest first, drained by update().
+// Presses are queued the moment the window reports them (see
+// onMouseButton/onKey), so everything that arrives in one frame or during
+// a slow one is kept, clicks and keys in the order they were made. A
+// fixed ring, so it never allocates.
+class InputQueue
+{
+private:
+    static const int CAPACITY = 64;
 
-    Card* wasteArray[52];
-    int wasteTop;
+    InputEvent events[CAPACITY];
+    int head;
+    int count;
+    long long dropped;
 
-    Card* selectedCard1;
-    Card* selectedCard2;
-    PyramidCard* selectedPyramid1;
-    PyramidCard* selectedPyramid2;
+public:
+    InputQueue() : head(0), count(0), dropped(0)
+    {
+    }
 
-    Card* currentWasteCard;
+    // Returns false (and counts the loss) when the queue is full
+    bool push(const InputEvent& event)
+    {
+        if (count == CAPACITY)
+        {
+            dropped++;
+            return false;
+        }
+        events[(head + count) % CAPACITY] = event;
+        count++;
+        return true;
+    }
 
-    int score;
-    int moves;
-    int currentGameScoreIndex;
-    bool isNewGame;
-    float gameTime;
-    bool gameWon;
-    bool gameLost;
+    bool pop(InputEvent& event)
+    {
+        if (count == 0)
+            return false;
+        event = events[head];
+        head = (head + 1) % CAPACITY;
+        count--;
+        return true;
+    }
 
-    Texture2D stockTexture;
-    Texture2D background;
-    Texture2D cardTextures[4][13];
+    bool isEmpty() const
+    {
+        return count == 0;
+    }
 
-    GameState currentState;
-    bool isPaused;
+    long long getDropped() const
+    {
+        return dropped;
+    }
+};
 
-    int highScores[5];
-    int highScoreCount;
+// raylib's desktop window is GLFW, built into the raylib library. raylib
+// reports at most one click per button between polls and does not time
+// presses, so the game puts its own callbacks in front of raylib's to see
+// every press as it arrives; --idle sleeps in GLFW until input comes.
+// raylib does not ship glfw3.h; these are the few declarations the game
+// needs from it.
+extern "C"
+{
+    typedef struct GLFWwindow GLFWwindow;
+    typedef void (*GLFWmousebuttonfun)(GLFWwindow* window, int button, int action, int mods);
+    typedef void (*GLFWkeyfun)(GLFWwindow* window, int key, int scancode, int action, int mods);
+
+    GLFWwindow* glfwGetCurrentContext(void);
+    GLFWmousebuttonfun glfwSetMouseButtonCallback(GLFWwindow* window, GLFWmousebuttonfun callback);
+    GLFWkeyfun glfwSetKeyCallback(GLFWwindow* window, GLFWkeyfun callback);
+    void glfwWaitEventsTimeout(double timeout);
+    void glfwPostEmptyEvent(void);
+}
+
+const int GLFW_PRESS = 1;
+const int GLFW_MOUSE_BUTTON_LEFT = 0;
+
+// Keys understood by replay files
+const int INPUT_KEY_COUNT = 3;
+const int inputKeyCodes[INPUT_KEY_COUNT] = { KEY_S, KEY_P, KEY_BACKSPACE };
+const char* inputKeyNames[INPUT_KEY_COUNT] = { "S", "P", "BACKSPACE" };
+
+const char* inputKeyName(int key)
+{
+    for (int i = 0; i < INPUT_KEY_COUNT; i++)
+    {
+        if (inputKeyCodes[i] == key)
+            return inputKeyNames[i];
+    }
+    return "?";
+}
 
-    const char* SCORE_FILE = "scores.txt";
-    const char* SAVE_FILE = "gamesave.dat";
+int inputKeyCode(const char* name)
+{
+    for (int i = 0; i < INPUT_KEY_COUNT; i++)
+    {
+        if (strcmp(inputKeyNames[i], name) == 0)
+            return inputKeyCodes[i];
+    }
+    return -1;
+}
 
-    const int CARD_WIDTH = 90;
-    const int CARD_HEIGHT = 130;
-    const int CARD_SPACING = 20;
+// Startup timeline: time to first frame broken down by phase.
+// mark() closes the current phase; report() logs the phases to the
+// console and, if a path is given, writes the same lines to a file.
+class StartupTimeline
+{
+private:
+    static const int MAX_PHASES = 16;
 
-    Card allCards[52];
-    PyramidCard allPyramidCards[28];
-    int cardCount;
-    Rectangle stockRect;
+    const char* names[MAX_PHASES];
+    double phaseMs[MAX_PHASES];
+    int phaseCount;
+    chrono::steady_clock::time_point processStart;
+    chrono::steady_clock::time_point lastMark;
+    bool reported;
 
-    Sound cardSelectSound;
-    Sound cardMatchSound;
-    Sound cardMismatchSound;
-    Sound stockDrawSound;
-    float soundVolume;
+public:
+    StartupTimeline()
+    {
+        phaseCount = 0;
+        reported = false;
+        processStart = chrono::steady_clock::now();
+        lastMark = processStart;
+    }
 
-    bool savedGameExists;
-    bool showSaveMessage;
-    float saveMessageTimer;
+    void mark(const char* phase)
+    {
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if (phaseCount < MAX_PHASES)
+        {
+            names[phaseCount] = phase;
+            phaseMs[phaseCount] = chrono::duration<double, milli>(now - lastMark).count();
+            phaseCount++;
+        }
+        lastMark = now;
+    }
 
-public:
-    PyramidSolitaire()
+    bool isReported()
     {
-        selectedCard1 = nullptr;
-        selectedCard2 = nullptr;
-        selectedPyramid1 = nullptr;
-        selectedPyramid2 = nullptr;
-        currentWasteCard = nullptr;
-        score = 0;
-        moves = 0;
-        currentGameScoreIndex = -1;
-        isNewGame = true;
-        gameTime = 0.0f;
-        gameWon = false;
-        gameLost = false;
-        cardCount = 0;
-        stockTop = -1;
-        wasteTop = -1;
-        currentState = MAIN_MENU;
-        isPaused = false;
-        highScoreCount = 0;
-        savedGameExists = false;
-        showSaveMessage = false;
-        saveMessageTimer = 0.0f;
-
-        loadHighScores();
-        checkSavedGame();
-        InitAudioDevice();
-
-        soundVolume = 0.7f;
-        loadAllSounds();
-        loadCardTextures();
-        stockRect = { 0, 0, 0, 0 };
+        return reported;
     }
 
-    ~PyramidSolitaire()
+    void report(const char* path)
     {
-        if (currentState == PLAYING && !gameWon && !gameLost && score > 0)
+        reported = true;
+        double totalMs = chrono::duration<double, milli>(lastMark - processStart).count();
+
+        ofstream file;
+        if (path)
         {
-            saveCurrentGameScore();
+            file.open(path, ios::trunc);
+            if (!file.is_open())
+                cout << "Error: Could not write startup report to " << path << endl;
         }
 
-        for (int s = 0; s < 4; s++)
+        for (int i = 0; i <= phaseCount; i++)
         {
-            for (int v = 0; v < 13; v++)
-            {
-                UnloadTexture(cardTextures[s][v]);
-            }
+            const char* line = (i < phaseCount)
+                ? TextFormat("startup %-20s %9.2f ms  %5.1f%%", names[i], phaseMs[i],
+                    (totalMs > 0) ? phaseMs[i] * 100.0 / totalMs : 0.0)
+                : TextFormat("startup %-20s %9.2f ms", "time to first frame", totalMs);
+            cout << line << endl;
+            if (file.is_open())
+                file << line << endl;
         }
-        UnloadTexture(background);
-        UnloadTexture(stockTexture);
+    }
+};
 
-        if (cardSelectSound.frameCount > 0)
-            UnloadSound(cardSelectSound);
-        if (cardMatchSound.frameCount > 0)
-            UnloadSound(cardMatchSound);
-        if (cardMismatchSound.frameCount > 0)
-            UnloadSound(cardMismatchSound);
-        if (stockDrawSound.frameCount > 0)
-            UnloadSound(stockDrawSound);
+StartupTimeline startupTimeline;
+
+// Asset pack (assets.pak, written by --pack-assets): card images and sound
+// effects stored already decoded, so startup maps one file instead of
+// opening and decoding ~60 JPG/MP3/WAV files. Entries are named by their
+// source path ("images/AH.JPG", "sounds/card_match.mp3").
+//
+// Layout: AssetPackHeader, entryCount AssetPackEntry records, then the
+// raw pixel / PCM data, each block aligned to ASSET_PACK_ALIGN bytes.
+const char ASSET_PACK_MAGIC[4] = { 'P', 'S', 'P', 'K' };
+const unsigned int ASSET_PACK_VERSION = 2;
+const unsigned int ASSET_PACK_ALIGN = 64;
+const char* ASSET_PACK_PATH = "assets.pak";
+
+enum AssetKind
+{
+    ASSET_IMAGE = 1,
+    ASSET_WAVE = 2
+};
 
-        CloseAudioDevice();
-    }
+struct AssetPackHeader
+{
+    char magic[4];
+    unsigned int version;
+    unsigned int entryCount;
+    unsigned int reserved;
+};
 
-    void checkSavedGame()
+// Images: a = width, b = height, c = pixel format, d = mipmaps
+// Waves:  a = frameCount, b = sampleRate, c = sampleSize, d = channels
+struct AssetPackEntry
+{
+    char name[48];
+    unsigned int kind;
+    unsigned int a, b, c, d;
+    unsigned int reserved;
+    unsigned long long offset;
+    unsigned long long size;
+};
+
+const int MAX_IMAGE_SIZE = 16384;
+const int MAX_IMAGE_MIPMAPS = 15;
+
+// Bytes of pixel data for an image including its mipmap chain, or -1 if
+// the dimensions, format or mipmap count are out of range (e.g. from a
+// damaged asset pack). Counted in 64 bits: GetPixelDataSize() returns an
+// int, which a large image would overflow.
+long long imageDataSize(int width, int height, int format, int mipmaps)
+{
+    if (width < 1 || width > MAX_IMAGE_SIZE || height < 1 || height > MAX_IMAGE_SIZE
+        || mipmaps < 1 || mipmaps > MAX_IMAGE_MIPMAPS)
+        return -1;
+
+    // 16x16 is exact for every format, compressed ones included
+    long long bitsPerPixel = GetPixelDataSize(16, 16, format) * 8LL / 256;
+    if (bitsPerPixel <= 0)
+        return -1;
+
+    long long size = 0;
+    for (int level = 0; level < mipmaps; level++)
     {
-        ifstream file(SAVE_FILE, ios::binary);
-        if (file.is_open())
-        {
-            savedGameExists = true;
-            file.close();
-        }
+        // Compressed formats round levels under 4x4 up to a whole block
+        if (width < 4 && height < 4)
+            size += GetPixelDataSize(width, height, format);
         else
+            size += (long long)width * height * bitsPerPixel / 8;
+        width = (width > 1) ? width / 2 : 1;
+        height = (height > 1) ? height / 2 : 1;
+    }
+    return size;
+}
+
+// Read-only view of an asset pack. POSIX maps the file with mmap; on
+// Windows the file is read with one fread, because <windows.h> clashes with
+// raylib's names. Returned Image/Wave data points into the pack, so it
+// must not be unloaded, and it stays valid until close().
+class AssetPack
+{
+private:
+    const unsigned char* data;
+    unsigned long long size;
+    bool mapped;
+    const AssetPackEntry* entries;
+    unsigned int entryCount;
+
+    const AssetPackEntry* find(const char* name, unsigned int kind) const
+    {
+        for (unsigned int i = 0; i < entryCount; i++)
         {
-            savedGameExists = false;
+            if (entries[i].kind == kind && strncmp(entries[i].name, name, sizeof(entries[i].name)) == 0)
+                return &entries[i];
         }
+        return NULL;
     }
 
-    void saveGame()
+    // Header and every entry must lie inside the file
+    bool validate() const
     {
-        ofstream file(SAVE_FILE, ios::binary | ios::trunc);
-        if (!file.is_open())
+        if (size < sizeof(AssetPackHeader))
+            return false;
+
+        const AssetPackHeader* header = (const AssetPackHeader*)data;
+        if (memcmp(header->magic, ASSET_PACK_MAGIC, 4) != 0 || header->version != ASSET_PACK_VERSION)
+            return false;
+        if (sizeof(AssetPackHeader) + (unsigned long long)header->entryCount * sizeof(AssetPackEntry) > size)
+            return false;
+
+        const AssetPackEntry* list = (const AssetPackEntry*)(data + sizeof(AssetPackHeader));
+        for (unsigned int i = 0; i < header->entryCount; i++)
         {
-            cout << "Error: Could not save game!" << endl;
-            return;
+            if (list[i].offset > size || list[i].size > size - list[i].offset)
+                return false;
+            if (list[i].name[sizeof(list[i].name) - 1] != '\0')
+                return false;
         }
+        return true;
+    }
 
-        // Write game state
-        file.write((char*)&score, sizeof(score));
-        file.write((char*)&moves, sizeof(moves));
-        file.write((char*)&gameTime, sizeof(gameTime));
-        file.write((char*)&stockTop, sizeof(stockTop));
-        file.write((char*)&wasteTop, sizeof(wasteTop));
+public:
+    AssetPack() : data(NULL), size(0), mapped(false), entries(NULL), entryCount(0) {}
 
-        // Write all 52 cards
-        for (int i = 0; i < 52; i++)
+    ~AssetPack()
+    {
+        close();
+    }
+
+    bool open(const char* path)
+    {
+        close();
+
+#ifndef _WIN32
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
         {
-            file.write((char*)&allCards[i].value, sizeof(allCards[i].value));
-            file.write((char*)&allCards[i].suit, sizeof(allCards[i].suit));
-            file.write((char*)&allCards[i].faceUp, sizeof(allCards[i].faceUp));
-            file.write((char*)&allCards[i].inPlay, sizeof(allCards[i].inPlay));
-            file.write((char*)&allCards[i].position, sizeof(allCards[i].position));
+            void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED)
+            {
+                // The whole pack is read at startup anyway
+                madvise(view, (size_t)info.st_size, MADV_WILLNEED);
+                data = (const unsigned char*)view;
+                size = (unsigned long long)info.st_size;
+                mapped = true;
+            }
         }
+        ::close(fd);
+#else
+        FILE* file = fopen(path, "rb");
+        if (!file)
+            return false;
 
-        // Write pyramid cards blocked status
-        for (int i = 0; i < 28; i++)
+        fseek(file, 0, SEEK_END);
+        long length = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        if (length > 0)
         {
-            file.write((char*)&allPyramidCards[i].blocked, sizeof(allPyramidCards[i].blocked));
+            unsigned char* buffer = new unsigned char[length];
+            if (fread(buffer, 1, (size_t)length, file) == (size_t)length)
+            {
+                data = buffer;
+                size = (unsigned long long)length;
+            }
+            else
+            {
+                delete[] buffer;
+            }
         }
+        fclose(file);
+#endif
 
-        // Write stock pile (card positions)
-        for (int i = 0; i <= stockTop; i++)
+        if (!data)
+            return false;
+        if (!validate())
         {
-            int pos = stockArray[i]->position;
-            file.write((char*)&pos, sizeof(pos));
+            cout << path << " is not a valid asset pack, loading individual files" << endl;
+            close();
+            return false;
         }
 
-        // Write waste pile (card positions)
-        for (int i = 0; i <= wasteTop; i++)
+        entryCount = ((const AssetPackHeader*)data)->entryCount;
+        entries = (const AssetPackEntry*)(data + sizeof(AssetPackHeader));
+        return true;
+    }
+
+    void close()
+    {
+        if (data)
         {
-            int pos = wasteArray[i]->position;
-            file.write((char*)&pos, sizeof(pos));
+#ifndef _WIN32
+            if (mapped)
+                munmap((void*)data, (size_t)size);
+#endif
+            if (!mapped)
+                delete[] data;
         }
+        data = NULL;
+        size = 0;
+        mapped = false;
+        entries = NULL;
+        entryCount = 0;
+    }
 
-        // Write current waste card position
-        int wastePos = (currentWasteCard != NULL) ? currentWasteCard->position : -1;
-        file.write((char*)&wastePos, sizeof(wastePos));
+    bool isOpen() const
+    {
+        return data != NULL;
+    }
 
-        file.close();
+    bool image(const char* name, Image& out) const
+    {
+        const AssetPackEntry* entry = find(name, ASSET_IMAGE);
+        if (!entry || entry->a > (unsigned int)MAX_IMAGE_SIZE || entry->b > (unsigned int)MAX_IMAGE_SIZE
+            || entry->d > (unsigned int)MAX_IMAGE_MIPMAPS)
+            return false;
+        long long size = imageDataSize((int)entry->a, (int)entry->b, (int)entry->c, (int)entry->d);
+        if (size < 0 || entry->size != (unsigned long long)size)
+            return false;
 
-        savedGameExists = true;
-        showSaveMessage = true;
-        saveMessageTimer = 2.0f;
-        cout << "Game saved successfully to " << SAVE_FILE << endl;
+        out.data = (void*)(data + entry->offset);
+        out.width = (int)entry->a;
+        out.height = (int)entry->b;
+        out.format = (int)entry->c;
+        out.mipmaps = (int)entry->d;
+        return true;
     }
 
-    bool loadGame()
+    bool wave(const char* name, Wave& out) const
     {
-        ifstream file(SAVE_FILE, ios::binary);
-        if (!file.is_open())
-        {
-            cout << "Error: Could not load game from " << SAVE_FILE << endl;
+        const AssetPackEntry* entry = find(name, ASSET_WAVE);
+        if (!entry || entry->size != (unsigned long long)entry->a * entry->d * entry->c / 8)
             return false;
-        }
 
-        // Clear current game
-        pyramidBST.clear();
-        stockTop = -1;
-        wasteTop = -1;
+        out.data = (void*)(data + entry->offset);
+        out.frameCount = entry->a;
+        out.sampleRate = entry->b;
+        out.sampleSize = entry->c;
+        out.channels = entry->d;
+        return true;
+    }
+};
 
-        // Read game state
-        file.read((char*)&score, sizeof(score));
-        file.read((char*)&moves, sizeof(moves));
-        file.read((char*)&gameTime, sizeof(gameTime));
-        file.read((char*)&stockTop, sizeof(stockTop));
-        file.read((char*)&wasteTop, sizeof(wasteTop));
+AssetPack assetPack;
 
-        // Read all 52 cards
-        for (int i = 0; i < 52; i++)
+// Image from the asset pack if it has one, otherwise decoded from the
+// file. mapped is set when the pixels belong to the pack.
+Image loadImageAsset(const char* path, bool& mapped)
+{
+    Image image = { 0 };
+    mapped = assetPack.image(path, image);
+    if (!mapped)
+        image = LoadImage(path);
+    return image;
+}
+
+void unloadImageAsset(Image image, bool mapped)
+{
+    if (!mapped)
+        UnloadImage(image);
+}
+
+// Sound from the asset pack if it has one, otherwise from the file;
+// frameCount 0 if neither exists
+Sound loadSoundAsset(const char* path)
+{
+    Wave wave = { 0 };
+    if (assetPack.wave(path, wave))
+        return LoadSoundFromWave(wave);
+    if (FileExists(path))
+        return LoadSound(path);
+
+    Sound none = { 0 };
+    return none;
+}
+
+// Card image files: images/<value><suit>.JPG, e.g. images/10H.JPG
+const char* cardSuitCodes[4] = { "H", "D", "C", "S" };
+const char* cardValueCodes[13] = { "A", "2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K" };
+
+string cardImagePath(int suit, int value)
+{
+    string path = "images/";
+    path += cardValueCodes[value - 1];
+    path += cardSuitCodes[suit];
+    path += ".JPG";
+    return path;
+}
+
+// Card textures are stored at twice the 90x130 on-screen card size, with
+// mipmaps: level 1 is exactly the on-screen size, level 0 keeps HiDPI
+// displays sharp, and trilinear filtering covers the sizes in between.
+// The source JPGs are up to 691x1056, so this also cuts texture memory.
+const int CARD_TEXTURE_WIDTH = 180;
+const int CARD_TEXTURE_HEIGHT = 260;
+
+// Resizes a decoded card/stock image and builds its mipmaps (CPU only)
+void prepareCardImage(Image* image)
+{
+    if (image->data == NULL)
+        return;
+    if (image->width != CARD_TEXTURE_WIDTH || image->height != CARD_TEXTURE_HEIGHT)
+        ImageResize(image, CARD_TEXTURE_WIDTH, CARD_TEXTURE_HEIGHT);
+    ImageMipmaps(image);
+}
+
+// Card image ready for upload; asset pack images are stored prepared
+Image loadCardImageAsset(const char* path, bool& mapped)
+{
+    Image image = loadImageAsset(path, mapped);
+    if (!mapped)
+        prepareCardImage(&image);
+    return image;
+}
+
+// Trilinear filtering needs the mipmaps; without them stay bilinear
+void setCardTextureFilter(Texture2D texture)
+{
+    SetTextureFilter(texture, (texture.mipmaps > 1) ? TEXTURE_FILTER_TRILINEAR : TEXTURE_FILTER_BILINEAR);
+}
+
+// Card texture atlas, built offline with --build-atlas: the 52 faces and
+// the stock back packed into one image, so the cards of a frame all come
+// from one texture and raylib can batch them. Cells are the card texture
+// size with a gutter, so filtering the first two mip levels never bleeds
+// between cards. Cell i holds suit i / 13, value i % 13 + 1; the last is
+// the stock.
+const int ATLAS_CELL_WIDTH = CARD_TEXTURE_WIDTH;
+const int ATLAS_CELL_HEIGHT = CARD_TEXTURE_HEIGHT;
+const int ATLAS_PADDING = 4;
+const int ATLAS_COLUMNS = 8;
+const int ATLAS_STOCK_CELL = 52;
+const int ATLAS_CELL_COUNT = 53;
+const char* ATLAS_IMAGE_PATH = "images/atlas.png";
+const char* ATLAS_REGIONS_PATH = "images/atlas.txt";
+
+// Region names in the atlas file: "AH", "10S", ..., "stock"
+string atlasCellName(int cell)
+{
+    if (cell == ATLAS_STOCK_CELL)
+        return "stock";
+    return string(cardValueCodes[cell % 13]) + cardSuitCodes[cell / 13];
+}
+
+// Startup image decoding. LoadImage only touches the CPU, so the JPG/PNG
+// decodes (or asset pack lookups) run on a small worker pool; the GPU uploads (LoadTextureFromImage)
+// must stay on the thread that owns the window.
+struct ImageDecodeJob
+{
+    string path;
+    Image image;
+    bool mapped;
+    bool cardImage;     // resize and mipmap with prepareCardImage
+
+    ImageDecodeJob() : image(), mapped(false), cardImage(false) {}
+};
+
+void decodeImagesParallel(ImageDecodeJob* jobs, int count)
+{
+    if (count <= 0)
+        return;
+
+    int workers = (int)thread::hardware_concurrency();
+    if (workers < 1)
+        workers = 1;
+    if (workers > count)
+        workers = count;
+
+    atomic<int> nextJob(0);
+    auto decodeJobs = [&]()
+    {
+        for (int i = nextJob++; i < count; i = nextJob++)
         {
-            file.read((char*)&allCards[i].value, sizeof(allCards[i].value));
-            file.read((char*)&allCards[i].suit, sizeof(allCards[i].suit));
-            file.read((char*)&allCards[i].faceUp, sizeof(allCards[i].faceUp));
-            file.read((char*)&allCards[i].inPlay, sizeof(allCards[i].inPlay));
-            file.read((char*)&allCards[i].position, sizeof(allCards[i].position));
+            if (jobs[i].cardImage)
+                jobs[i].image = loadCardImageAsset(jobs[i].path.c_str(), jobs[i].mapped);
+            else
+                jobs[i].image = loadImageAsset(jobs[i].path.c_str(), jobs[i].mapped);
         }
+    };
+
+    // The calling thread is one of the workers
+    thread* pool = new thread[workers - 1];
+    for (int i = 0; i < workers - 1; i++)
+        pool[i] = thread(decodeJobs);
+    decodeJobs();
+    for (int i = 0; i < workers - 1; i++)
+        pool[i].join();
+    delete[] pool;
+}
+
+// Source image of an atlas cell
+string atlasCellImagePath(int cell)
+{
+    if (cell == ATLAS_STOCK_CELL)
+        return "images/stock.jpg";
+    return cardImagePath(cell / 13, cell % 13 + 1);
+}
 
-        // Read pyramid cards blocked status and rebuild BST
-        for (int i = 0; i < 28; i++)
+int atlasCellIndex(const string& name)
+{
+    for (int i = 0; i < ATLAS_CELL_COUNT; i++)
+    {
+        if (atlasCellName(i) == name)
+            return i;
+    }
+    return -1;
+}
+
+// Sound effects and their files. Run --pack-assets to store them as
+// decoded PCM, so startup does not decode the MP3s.
+enum SoundEffect
+{
+    SFX_CARD_SELECT,
+    SFX_CARD_MATCH,
+    SFX_CARD_MISMATCH,
+    SFX_STOCK_DRAW,
+    SFX_COUNT
+};
+
+const char* soundEffectPaths[SFX_COUNT] = { "sounds/card_select.mp3", "sounds/card_match.mp3",
+    "sounds/card_mismatch.wav", "sounds/stock-draw.wav" };
+
+// Preallocated voices for the sound effects. Each effect's PCM is loaded
+// once, and its voices are aliases of it (LoadSoundAlias), so a quick
+// second click overlaps the first instead of restarting it. An effect
+// plays at most VOICES_PER_EFFECT copies at once; a further play takes
+// over that effect's oldest voice. With MAX_ACTIVE_VOICES already
+// playing, the oldest voice of any effect is stopped first, which bounds
+// the mixer's work.
+class SoundVoicePool
+{
+private:
+    static const int VOICES_PER_EFFECT = 3;
+    static const int MAX_ACTIVE_VOICES = 6;
+
+    struct Voice
+    {
+        Sound sound;
+        unsigned long long startedAt;
+    };
+
+    Sound sources[SFX_COUNT];
+    Voice voices[SFX_COUNT][VOICES_PER_EFFECT];
+    unsigned long long playCount;
+
+    // Oldest playing voice of one effect, or of all of them (effect < 0)
+    Voice* oldestPlaying(int effect)
+    {
+        Voice* oldest = NULL;
+        for (int e = 0; e < SFX_COUNT; e++)
         {
-            file.read((char*)&allPyramidCards[i].blocked, sizeof(allPyramidCards[i].blocked));
+            if ((effect >= 0 && e != effect) || sources[e].frameCount == 0)
+                continue;
+            for (int v = 0; v < VOICES_PER_EFFECT; v++)
+            {
+                Voice& voice = voices[e][v];
+                if (IsSoundPlaying(voice.sound) && (!oldest || voice.startedAt < oldest->startedAt))
+                    oldest = &voice;
+            }
         }
+        return oldest;
+    }
 
-        // Rebuild pyramid structure
-        int cardIdx = 0;
-        for (int row = 0; row < 7; row++)
+    int activeVoices()
+    {
+        int active = 0;
+        for (int e = 0; e < SFX_COUNT; e++)
         {
-            for (int col = 0; col <= row; col++)
+            if (sources[e].frameCount == 0)
+                continue;
+            for (int v = 0; v < VOICES_PER_EFFECT; v++)
             {
+                if (IsSoundPlaying(voices[e][v].sound))
+                    active++;
+            }
+        }
+        return active;
+    }
 
-                allPyramidCards[cardIdx].card = &allCards[cardIdx];
-                allPyramidCards[cardIdx].row = row;
-                allPyramidCards[cardIdx].col = col;
-                allPyramidCards[cardIdx].leftChildPos = (row + 1) * 100 + col;
-                allPyramidCards[cardIdx].rightChildPos = (row + 1) * 100 + (col + 1);
+public:
+    SoundVoicePool() : playCount(0)
+    {
+        for (int e = 0; e < SFX_COUNT; e++)
+        {
+            sources[e] = Sound{};
+            for (int v = 0; v < VOICES_PER_EFFECT; v++)
+                voices[e][v] = { Sound{}, 0 };
+        }
+    }
 
-                pyramidBST.insert(allPyramidCards[cardIdx]);
-                cardIdx++;
-            }
+    // Needs an open audio device; missing files stay silent
+    void load()
+    {
+        for (int e = 0; e < SFX_COUNT; e++)
+        {
+            sources[e] = loadSoundAsset(soundEffectPaths[e]);
+            if (sources[e].frameCount == 0)
+                continue;
+            for (int v = 0; v < VOICES_PER_EFFECT; v++)
+                voices[e][v].sound = LoadSoundAlias(sources[e]);
         }
+    }
 
-        // Read stock pile
-        for (int i = 0; i <= stockTop; i++)
+    void unload()
+    {
+        for (int e = 0; e < SFX_COUNT; e++)
         {
-            int pos;
-            file.read((char*)&pos, sizeof(pos));
-            stockArray[i] = &allCards[pos];
+            if (sources[e].frameCount == 0)
+                continue;
+            for (int v = 0; v < VOICES_PER_EFFECT; v++)
+                UnloadSoundAlias(voices[e][v].sound);
+            UnloadSound(sources[e]);
+            sources[e] = Sound{};
         }
+    }
 
-        // Read waste pile
-        for (int i = 0; i <= wasteTop; i++)
+    void setVolume(float volume)
+    {
+        for (int e = 0; e < SFX_COUNT; e++)
         {
-            int pos;
-            file.read((char*)&pos, sizeof(pos));
-            wasteArray[i] = &allCards[pos];
+            if (sources[e].frameCount == 0)
+                continue;
+            for (int v = 0; v < VOICES_PER_EFFECT; v++)
+                SetSoundVolume(voices[e][v].sound, volume);
         }
+    }
 
-        // Read current waste card
-        int wastePos;
-        file.read((char*)&wastePos, sizeof(wastePos));
-        currentWasteCard = (wastePos >= 0) ? &allCards[wastePos] : NULL;
+    void play(int effect)
+    {
+        if (sources[effect].frameCount == 0)
+            return;
 
-        file.close();
+        Voice* voice = NULL;
+        for (int v = 0; v < VOICES_PER_EFFECT && !voice; v++)
+        {
+            if (!IsSoundPlaying(voices[effect][v].sound))
+                voice = &voices[effect][v];
+        }
 
-        // Reset selection and flags
-        selectedCard1 = nullptr;
-        selectedCard2 = nullptr;
-        selectedPyramid1 = nullptr;
-        selectedPyramid2 = nullptr;
-        gameWon = false;
-        gameLost = false;
-        isNewGame = false;
-        cardCount = 52;
+        if (!voice)
+        {
+            // The audio thread may have finished them all since the scan
+            voice = oldestPlaying(effect);
+            if (!voice)
+                voice = &voices[effect][0];
+        }
+        else if (activeVoices() >= MAX_ACTIVE_VOICES)
+        {
+            Voice* stolen = oldestPlaying(-1);
+            if (stolen)
+                StopSound(stolen->sound);
+        }
 
-        currentState = PLAYING;
-        cout << "Game loaded successfully from " << SAVE_FILE << endl;
-        return true;
+        voice->startedAt = ++playCount;
+        PlaySound(voice->sound);
     }
+};
 
-    void deleteSavedGame()
+// Background music, streamed: the MP3 is decoded a buffer at a time
+// instead of being loaded whole with LoadSound. The stream is refilled
+// from its own thread every few milliseconds, so a slow frame on the
+// main thread cannot starve it. Every raylib music call is made under
+// musicLock, because the main thread can change the volume.
+class BackgroundMusic
+{
+private:
+    // Frames per stream sub-buffer. raylib double-buffers, so at 44.1 kHz
+    // this holds about 0.2 s of audio; refills happen every 10 ms.
+    static const int STREAM_BUFFER_FRAMES = 4096;
+    static const int REFILL_INTERVAL_MS = 10;
+
+    Music music;
+    bool loaded;
+    thread updater;
+    mutex musicLock;
+    atomic<bool> running;
+
+    void refillLoop()
     {
-        if (remove(SAVE_FILE) == 0)
+        while (running)
         {
-            cout << "Saved game deleted." << endl;
+            {
+                lock_guard<mutex> guard(musicLock);
+                UpdateMusicStream(music);
+            }
+            this_thread::sleep_for(chrono::milliseconds(REFILL_INTERVAL_MS));
         }
-        savedGameExists = false;
     }
 
-    void loadAllSounds()
+public:
+    BackgroundMusic() : loaded(false), running(false)
     {
-        cardSelectSound = { 0 };
-        cardMatchSound = { 0 };
-        cardMismatchSound = { 0 };
-        stockDrawSound = { 0 };
-
-        if (FileExists("sounds/card_select.mp3"))
-            cardSelectSound = LoadSound("sounds/card_select.mp3");
-        if (FileExists("sounds/card_match.mp3"))
-            cardMatchSound = LoadSound("sounds/card_match.mp3");
-        if (FileExists("sounds/card_mismatch.wav"))
-            cardMismatchSound = LoadSound("sounds/card_mismatch.wav");
-        if (FileExists("sounds/stock_draw.wav"))
-            stockDrawSound = LoadSound("sounds/stock_draw.wav");
+        music = Music{};
+    }
 
-        setSoundVolume(soundVolume);
+    ~BackgroundMusic()
+    {
+        stop();
     }
 
-    void setSoundVolume(float volume)
+    // Needs an open audio device; does nothing if the file is missing
+    void start(const char* path, float volume)
     {
-        soundVolume = volume;
-        if (cardSelectSound.frameCount > 0)
-            SetSoundVolume(cardSelectSound, volume);
-        if (cardMatchSound.frameCount > 0)
-            SetSoundVolume(cardMatchSound, volume);
-        if (cardMismatchSound.frameCount > 0)
-            SetSoundVolume(cardMismatchSound, volume);
-        if (stockDrawSound.frameCount > 0)
-            SetSoundVolume(stockDrawSound, volume);
+        stop();
+        if (!FileExists(path))
+            return;
+
+        SetAudioStreamBufferSizeDefault(STREAM_BUFFER_FRAMES);
+        music = LoadMusicStream(path);
+        SetAudioStreamBufferSizeDefault(0);
+        if (music.frameCount == 0)
+            return;
+
+        loaded = true;
+        music.looping = true;
+        SetMusicVolume(music, volume);
+        PlayMusicStream(music);
+
+        running = true;
+        updater = thread(&BackgroundMusic::refillLoop, this);
     }
 
-    void playCardSelectSound()
+    void setVolume(float volume)
     {
-        if (cardSelectSound.frameCount > 0)
-            PlaySound(cardSelectSound);
+        if (!loaded)
+            return;
+        lock_guard<mutex> guard(musicLock);
+        SetMusicVolume(music, volume);
     }
 
-    void playCardMatchSound()
+    // Must run before CloseAudioDevice()
+    void stop()
     {
-        if (cardMatchSound.frameCount > 0)
-            PlaySound(cardMatchSound);
+        running = false;
+        if (updater.joinable())
+            updater.join();
+
+        if (loaded)
+        {
+            StopMusicStream(music);
+            UnloadMusicStream(music);
+            loaded = false;
+        }
     }
+};
 
-    void playCardMismatchSound()
+// Card face textures, loaded the first time a card is drawn instead of all
+// 52 at startup. prefetch() queues a face for decoding on worker threads;
+// the GPU upload still happens on the main thread, in get() or endFrame().
+// At the end of a frame, faces are unloaded least recently drawn first
+// while the resident total is over the budget (0 = no limit). Faces drawn
+// in the current frame are never evicted, so a budget below one frame's
+// cards is exceeded rather than thrashed. Faces drawn into a cached layer
+// since beginLayer() count as drawn every frame, since that layer is.
+class CardTextureCache
+{
+private:
+    enum SlotState
+    {
+        SLOT_EMPTY,
+        SLOT_QUEUED,
+        SLOT_DECODING,
+        SLOT_DECODED,
+        SLOT_RESIDENT,
+        SLOT_MISSING
+    };
+
+    struct Slot
     {
-        if (cardMismatchSound.frameCount > 0)
-            PlaySound(cardMismatchSound);
+        int state;
+        bool inQueue;
+        Image image;
+        bool mapped;
+        Texture2D texture;
+        long long bytes;
+        long long lastDrawn;
+    };
+
+    Slot slots[52];
+    long long frame;
+    long long layerFrame;   // frame the cached layer was last drawn in, -1 if none
+    long long budgetBytes;
+    long long residentBytes;
+    long long peakBytes;
+    int loads;
+    int prefetchedLoads;
+    int evictions;
+
+    mutex lock;
+    condition_variable decoded;
+    condition_variable queued;
+    thread workers[4];
+    int workerCount;
+    bool stopping;
+    int queue[52];
+    int queueHead;
+    int queueCount;
+
+    static string imagePath(int card)
+    {
+        return cardImagePath(card / 13, card % 13 + 1);
     }
 
-    void playStockDrawSound()
+    Image decode(int card, bool& mapped)
     {
-        if (stockDrawSound.frameCount > 0)
-            PlaySound(stockDrawSound);
+        return loadCardImageAsset(imagePath(card).c_str(), mapped);
     }
 
-    void loadHighScores()
+    // Caller holds the lock and has set the slot to SLOT_DECODING
+    void finishDecode(Slot& slot, Image image, bool mapped)
     {
-        ifstream file(SCORE_FILE);
-        highScoreCount = 0;
+        slot.image = image;
+        slot.mapped = mapped;
+        slot.state = (image.data != NULL) ? SLOT_DECODED : SLOT_MISSING;
+        decoded.notify_all();
+    }
 
-        if (!file.is_open())
+    // Main thread only; caller holds the lock
+    void upload(Slot& slot)
+    {
+        slot.texture = LoadTextureFromImage(slot.image);
+        unloadImageAsset(slot.image, slot.mapped);
+        slot.image = Image{};
+        if (slot.texture.id == 0)
+        {
+            slot.state = SLOT_MISSING;
             return;
+        }
 
-        while (highScoreCount < 5 && file >> highScores[highScoreCount])
+        setCardTextureFilter(slot.texture);
+        slot.state = SLOT_RESIDENT;
+        slot.bytes = imageDataSize(slot.texture.width, slot.texture.height, slot.texture.format,
+            slot.texture.mipmaps);
+        if (slot.bytes < 0)
+            slot.bytes = 0;
+        residentBytes += slot.bytes;
+        if (residentBytes > peakBytes)
+            peakBytes = residentBytes;
+        loads++;
+    }
+
+    // Decodes the next queued face, if any; the lock is released while
+    // decoding. Returns false when the queue is empty.
+    bool decodeNextQueued(unique_lock<mutex>& guard)
+    {
+        while (queueCount > 0)
         {
-            highScoreCount++;
+            int card = queue[queueHead];
+            queueHead = (queueHead + 1) % 52;
+            queueCount--;
+
+            Slot& slot = slots[card];
+            slot.inQueue = false;
+            if (slot.state != SLOT_QUEUED)
+                continue;   // already decoded by get()
+
+            slot.state = SLOT_DECODING;
+            bool mapped = false;
+            guard.unlock();
+            Image image = decode(card, mapped);
+            guard.lock();
+            finishDecode(slot, image, mapped);
+            return true;
         }
-        file.close();
+        return false;
+    }
 
-        // Sort high scores in descending order
-        for (int i = 0; i < highScoreCount - 1; i++)
+    void decodeQueued()
+    {
+        unique_lock<mutex> guard(lock);
+        while (true)
         {
-            for (int j = i + 1; j < highScoreCount; j++)
-            {
-                if (highScores[j] > highScores[i])
-                {
-                    int temp = highScores[i];
-                    highScores[i] = highScores[j];
-                    highScores[j] = temp;
-                }
-            }
+            while (!stopping && queueCount == 0)
+                queued.wait(guard);
+            if (stopping)
+                return;
+            decodeNextQueued(guard);
         }
     }
 
-    void saveHighScores()
+public:
+    CardTextureCache()
     {
-        ofstream file(SCORE_FILE, ios::trunc);
-        if (!file.is_open())
+        for (int i = 0; i < 52; i++)
         {
-            cout << "Error: Could not save high scores!" << endl;
-            return;
+            slots[i].state = SLOT_EMPTY;
+            slots[i].inQueue = false;
+            slots[i].image = Image{};
+            slots[i].mapped = false;
+            slots[i].texture = Texture2D{};
+            slots[i].bytes = 0;
+            slots[i].lastDrawn = -1;
         }
+        frame = 0;
+        layerFrame = -1;
+        budgetBytes = 0;
+        residentBytes = 0;
+        peakBytes = 0;
+        loads = 0;
+        prefetchedLoads = 0;
+        evictions = 0;
+        workerCount = 0;
+        stopping = false;
+        queueHead = 0;
+        queueCount = 0;
+    }
 
-        for (int i = 0; i < highScoreCount; i++)
-        {
-            file << highScores[i] << endl;
-        }
-        file.close();
-        cout << "High scores saved successfully." << endl;
+    ~CardTextureCache()
+    {
+        shutdown();
     }
 
-    void saveCurrentGameScore()
+    void setBudget(long long bytes)
     {
-        if (isNewGame)
+        budgetBytes = (bytes > 0) ? bytes : 0;
+    }
+
+    // Texture for card = suit * 13 + value - 1; id 0 if the image is missing
+    Texture2D get(int card)
+    {
+        unique_lock<mutex> guard(lock);
+        Slot& slot = slots[card];
+
+        if (slot.state == SLOT_EMPTY || slot.state == SLOT_QUEUED)
         {
-            if (highScoreCount < 5)
-            {
-                currentGameScoreIndex = highScoreCount;
-                highScores[highScoreCount++] = score;
-            }
-            else
-            {
-                if (score > highScores[4])
-                {
-                    currentGameScoreIndex = 4;
-                    highScores[4] = score;
-                }
-            }
-            isNewGame = false;
+            // Needed now: decode here rather than wait behind the queue
+            slot.state = SLOT_DECODING;
+            bool mapped = false;
+            guard.unlock();
+            Image image = decode(card, mapped);
+            guard.lock();
+            finishDecode(slot, image, mapped);
         }
-        else if (currentGameScoreIndex >= 0 && currentGameScoreIndex < 5)
+        else if (slot.state == SLOT_DECODED)
         {
-            highScores[currentGameScoreIndex] = score;
+            prefetchedLoads++;
         }
 
-        // Sort high scores
-        for (int i = 0; i < highScoreCount - 1; i++)
+        // A worker is decoding this face: help with the queue meanwhile
+        while (slot.state == SLOT_DECODING)
         {
-            for (int j = i + 1; j < highScoreCount; j++)
-            {
-                if (highScores[j] > highScores[i])
-                {
-                    int temp = highScores[i];
-                    highScores[i] = highScores[j];
-                    highScores[j] = temp;
-                }
-            }
+            if (!decodeNextQueued(guard))
+                decoded.wait(guard);
         }
+        if (slot.state == SLOT_DECODED)
+            upload(slot);
+        if (slot.state != SLOT_RESIDENT)
+            return Texture2D{};
 
-        saveHighScores();
+        slot.lastDrawn = frame;
+        return slot.texture;
     }
 
-    void loadCardTextures()
+    // Call before redrawing the cached layer: faces drawn from now until
+    // the next call stay on screen through it, and are not evicted
+    void beginLayer()
     {
-        const char* suits[4] = { "H", "D", "C", "S" };
-        const char* values[13] = { "A", "2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K" };
-
-        for (int s = 0; s < 4; s++)
-        {
-            for (int v = 0; v < 13; v++)
-            {
-                string path = "images/";
-                path += values[v];
-                path += suits[s];
-                path += ".JPG";
-                cardTextures[s][v] = LoadTexture(path.c_str());
-            }
-        }
-
-        stockTexture = LoadTexture("images/stock.jpg");
-        background = LoadTexture("images/background.jpg");
+        lock_guard<mutex> guard(lock);
+        layerFrame = frame;
     }
 
-    void initGame()
+    void prefetch(int card)
     {
-        pyramidBST.clear();
-        stockTop = -1;
-        wasteTop = -1;
-
-        selectedCard1 = nullptr;
-        selectedCard2 = nullptr;
-        selectedPyramid1 = nullptr;
-        selectedPyramid2 = nullptr;
-        currentWasteCard = nullptr;
-        score = 0;
-        moves = 0;
-        gameTime = 0.0f;
-        gameWon = false;
-        gameLost = false;
-        cardCount = 0;
-
-        isNewGame = true;
-        currentGameScoreIndex = -1;
-
-        createDeck();
-        shuffleDeck();
-        createPyramid();
+        lock_guard<mutex> guard(lock);
+        Slot& slot = slots[card];
+        if (slot.state != SLOT_EMPTY)
+            return;
 
-        // Add remaining cards to stock
-        for (int i = 28; i < 52; i++)
+        slot.state = SLOT_QUEUED;
+        if (!slot.inQueue)
         {
-            stockArray[++stockTop] = &allCards[i];
+            slot.inQueue = true;
+            queue[(queueHead + queueCount) % 52] = card;
+            queueCount++;
         }
 
-        deleteSavedGame();
-        currentState = PLAYING;
+        // Workers start on the first prefetch; the main thread decodes too
+        // when get() needs a face that is still queued
+        if (workerCount == 0)
+        {
+            int count = (int)thread::hardware_concurrency() - 1;
+            count = (count < 1) ? 1 : (count > 4) ? 4 : count;
+            for (int i = 0; i < count; i++)
+                workers[i] = thread(&CardTextureCache::decodeQueued, this);
+            workerCount = count;
+        }
+        queued.notify_one();
     }
 
-    void createDeck()
+    // Call after EndDrawing(): uploads finished prefetches, then evicts
+    // down to the budget. A face uploaded here counts as drawn this frame,
+    // so a tight budget does not throw away what was just prefetched.
+    void endFrame()
     {
-        cardCount = 0;
-        for (int suit = 0; suit < 4; suit++)
+        lock_guard<mutex> guard(lock);
+        for (int i = 0; i < 52; i++)
         {
-            for (int value = 1; value <= 13; value++)
+            if (slots[i].state == SLOT_DECODED)
             {
-                allCards[cardCount] = Card(value, suit, cardCount);
-                cardCount++;
+                upload(slots[i]);
+                slots[i].lastDrawn = frame;
+            }
+        }
+
+        long long keepFrom = (layerFrame >= 0) ? layerFrame : frame;
+        while (budgetBytes > 0 && residentBytes > budgetBytes)
+        {
+            int oldest = -1;
+            for (int i = 0; i < 52; i++)
+            {
+                if (slots[i].state == SLOT_RESIDENT && slots[i].lastDrawn < keepFrom &&
+                    (oldest < 0 || slots[i].lastDrawn < slots[oldest].lastDrawn))
+                    oldest = i;
             }
+            if (oldest < 0)
+                break;
+
+            UnloadTexture(slots[oldest].texture);
+            slots[oldest].texture = Texture2D{};
+            slots[oldest].state = SLOT_EMPTY;
+            residentBytes -= slots[oldest].bytes;
+            evictions++;
         }
+
+        frame++;
     }
 
-    void shuffleDeck()
+    // Stops the worker and unloads everything
+    void shutdown()
     {
-        srand(time(nullptr));
-
-        for (int i = 51; i > 0; i--)
         {
-            int j = rand() % (i + 1);
-            Card temp = allCards[i];
-            allCards[i] = allCards[j];
-            allCards[j] = temp;
+            lock_guard<mutex> guard(lock);
+            stopping = true;
         }
+        queued.notify_all();
+        for (int i = 0; i < workerCount; i++)
+            workers[i].join();
+        workerCount = 0;
 
-        // Update positions after shuffling
         for (int i = 0; i < 52; i++)
         {
-            allCards[i].position = i;
+            if (slots[i].state == SLOT_RESIDENT)
+                UnloadTexture(slots[i].texture);
+            else if (slots[i].state == SLOT_DECODED)
+                unloadImageAsset(slots[i].image, slots[i].mapped);
+            slots[i].state = SLOT_EMPTY;
         }
+        residentBytes = 0;
     }
 
-    void createPyramid()
+    void report() const
     {
-        int cardIndex = 0;
+        if (loads == 0)
+            return;
+        cout << "Card texture cache: " << loads << " loads (" << prefetchedLoads
+            << " prefetched), " << evictions << " evictions, peak "
+            << peakBytes / 1024 << " KB";
+        if (budgetBytes > 0)
+            cout << " of " << budgetBytes / 1024 << " KB budget";
+        cout << endl;
+    }
+};
 
-        for (int row = 0; row < 7; row++)
+// Draw commands for one pass (a frame, or a table layer rebuild). Drawing
+// code records commands with a layer; submit() sorts them by layer, then
+// by texture, and issues them to raylib, so commands sharing a texture are
+// sent together and raylib can batch them. The sort is stable: commands
+// with equal keys keep their recorded order, so anything that must
+// overlap in a particular order needs its own layer. Storage is allocated
+// on first use; recording and submitting never allocate.
+class DrawList
+{
+public:
+    struct Stats
+    {
+        long long submits;
+        long long commands;
+        long long textureSwitches;
+        double submitSeconds;
+    };
+
+private:
+    enum CommandKind
+    {
+        DRAW_TEXTURE,
+        DRAW_RECT,
+        DRAW_RECT_LINES,
+        DRAW_TEXT
+    };
+
+    struct Command
+    {
+        int layer;
+        unsigned int textureKey;
+        int kind;
+        Texture2D texture;
+        Rectangle source;
+        Rectangle dest;
+        Color color;
+        float thickness;
+        int fontSize;
+        char text[40];
+    };
+
+    static const int CAPACITY = 256;
+
+    Command* commands;
+    short* order;
+    int count;
+    Stats stats;
+
+    Command* add(int layer, int kind, unsigned int textureKey)
+    {
+        if (!commands)
         {
-            for (int col = 0; col <= row; col++)
-            {
-                Card* card = &allCards[cardIndex];
-                card->faceUp = true;
+            commands = new Command[CAPACITY];
+            order = new short[CAPACITY];
+        }
+        // Full: send what is recorded so far, which keeps every command
+        // but limits sorting to each batch
+        if (count == CAPACITY)
+            submit();
+
+        Command& command = commands[count];
+        command.layer = layer;
+        command.kind = kind;
+        command.textureKey = textureKey;
+        order[count] = (short)count;
+        count++;
+        return &command;
+    }
 
-                PyramidCard pyramidCard(card, row, col);
-                allPyramidCards[cardIndex] = pyramidCard;
+    static bool before(const Command& a, const Command& b)
+    {
+        if (a.layer != b.layer)
+            return a.layer < b.layer;
+        return a.textureKey < b.textureKey;
+    }
 
-                pyramidBST.insert(pyramidCard);
+public:
+    DrawList() : commands(NULL), order(NULL), count(0)
+    {
+        stats = Stats();
+    }
 
-                cardIndex++;
-            }
-        }
+    ~DrawList()
+    {
+        delete[] commands;
+        delete[] order;
+    }
 
-        updateBlockedStatus();
+    void texture(int layer, Texture2D texture, Rectangle source, Rectangle dest, Color tint)
+    {
+        Command* command = add(layer, DRAW_TEXTURE, texture.id);
+        command->texture = texture;
+        command->source = source;
+        command->dest = dest;
+        command->color = tint;
     }
 
-    void updateBlockedStatus()
+    void rect(int layer, Rectangle rect, Color color)
     {
-        // Using BST to efficiently check child blocking status
-        for (int i = 0; i < 28; i++)
-        {
-            PyramidCard& pc = allPyramidCards[i];
+        Command* command = add(layer, DRAW_RECT, GetShapesTexture().id);
+        command->dest = rect;
+        command->color = color;
+    }
 
-            if (!pc.card || !pc.card->inPlay)
-            {
-                pc.blocked = false;
-                continue;
-            }
+    void rectLines(int layer, Rectangle rect, float thickness, Color color)
+    {
+        Command* command = add(layer, DRAW_RECT_LINES, GetShapesTexture().id);
+        command->dest = rect;
+        command->thickness = thickness;
+        command->color = color;
+    }
 
-            if (pc.row == 6)
-            {
-                pc.blocked = false;
-                continue;
-            }
+    // Text longer than 39 bytes is cut
+    void text(int layer, const char* text, int x, int y, int fontSize, Color color)
+    {
+        Command* command = add(layer, DRAW_TEXT, GetFontDefault().texture.id);
+        strncpy(command->text, text, sizeof(command->text) - 1);
+        command->text[sizeof(command->text) - 1] = '\0';
+        command->dest = { (float)x, (float)y, 0, 0 };
+        command->fontSize = fontSize;
+        command->color = color;
+    }
 
-            bool leftBlocking = false;
-            bool rightBlocking = false;
+    void submit()
+    {
+        auto start = chrono::steady_clock::now();
 
-            // Search for left child in BST
-            PyramidCard leftSearch;
-            leftSearch.row = pc.row + 1;
-            leftSearch.col = pc.col;
-            BSTNode<PyramidCard>* leftNode = pyramidBST.search(leftSearch);
-            if (leftNode && leftNode->data.card && leftNode->data.card->inPlay)
+        // Insertion sort of the indices: stable, in place, and fast for
+        // lists this short that are mostly in order already
+        for (int i = 1; i < count; i++)
+        {
+            short index = order[i];
+            int j = i - 1;
+            while (j >= 0 && before(commands[index], commands[order[j]]))
             {
-                leftBlocking = true;
+                order[j + 1] = order[j];
+                j--;
             }
+            order[j + 1] = index;
+        }
 
-            // Search for right child in BST
-            PyramidCard rightSearch;
-            rightSearch.row = pc.row + 1;
-            rightSearch.col = pc.col + 1;
-            BSTNode<PyramidCard>* rightNode = pyramidBST.search(rightSearch);
-            if (rightNode && rightNode->data.card && rightNode->data.card->inPlay)
+        unsigned int currentTexture = 0;
+        for (int i = 0; i < count; i++)
+        {
+            const Command& command = commands[order[i]];
+            if (i == 0 || command.textureKey != currentTexture)
+                stats.textureSwitches++;
+            currentTexture = command.textureKey;
+
+            switch (command.kind)
             {
-                rightBlocking = true;
+            case DRAW_TEXTURE:
+                DrawTexturePro(command.texture, command.source, command.dest, { 0, 0 }, 0, command.color);
+                break;
+            case DRAW_RECT:
+                DrawRectangleRec(command.dest, command.color);
+                break;
+            case DRAW_RECT_LINES:
+                DrawRectangleLinesEx(command.dest, command.thickness, command.color);
+                break;
+            case DRAW_TEXT:
+                DrawText(command.text, (int)command.dest.x, (int)command.dest.y, command.fontSize, command.color);
+                break;
             }
-
-            pc.blocked = leftBlocking || rightBlocking;
         }
+
+        stats.submits++;
+        stats.commands += count;
+        stats.submitSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        count = 0;
     }
 
-    bool isCardFree(PyramidCard* pc)
+    const Stats& getStats() const
     {
-        if (!pc || !pc->card || !pc->card->inPlay)
-            return false;
-        return !pc->blocked;
+        return stats;
     }
 
-    bool isValidMove(Card* c1, Card* c2)
+    // Averages per submit (--draw-stats)
+    void report(const char* name) const
     {
-        if (!c1 || !c2)
-            return false;
-        if (!c1->inPlay || !c2->inPlay)
-            return false;
-        return (c1->value + c2->value) == 13;
+        if (stats.submits == 0)
+            return;
+        double submits = (double)stats.submits;
+        printf("%-14s %8lld passes  %6.1f draws  %5.1f texture switches  %7.1f us submit\n",
+            name, stats.submits, stats.commands / submits, stats.textureSwitches / submits,
+            stats.submitSeconds * 1e6 / submits);
     }
+};
 
-    bool isKing(Card* c)
+// Cards in motion: matched cards flying off to the foundation and stock
+// draws flipping over onto the waste pile. The pool is a fixed array, so
+// starting, updating and drawing animations never allocates; when it is
+// full a new animation is simply not started and the card moves at once.
+enum CardAnimationKind
+{
+    ANIM_FLIGHT,    // moves and shrinks away; the card is already gone from the table
+    ANIM_FLIP       // turns over on the way; the table hides the card until it lands
+};
+
+class CardAnimationPool
+{
+public:
+    struct Animation
     {
-        if (!c)
-            return false;
-        return c->value == 13;
+        bool active;
+        int kind;
+        Card* card;
+        Rectangle from;
+        Rectangle to;
+        float elapsed;
+        float duration;
+    };
+
+    static const int CAPACITY = 8;
+
+private:
+    Animation animations[CAPACITY];
+    int activeCount;
+
+public:
+    CardAnimationPool()
+    {
+        clear();
     }
 
-    void drawCardFromStock()
+    void clear()
     {
-        playStockDrawSound();
+        for (int i = 0; i < CAPACITY; i++)
+            animations[i].active = false;
+        activeCount = 0;
+    }
 
-        // If stock is empty, recycle waste pile
-        if (stockTop < 0)
+    // Replaces any animation already running for card
+    bool start(int kind, Card* card, Rectangle from, Rectangle to, float duration)
+    {
+        Animation* slot = NULL;
+        for (int i = 0; i < CAPACITY; i++)
         {
-            // Move all in-play waste cards back to stock
-            while (wasteTop >= 0)
+            if (animations[i].active && animations[i].card == card)
             {
-                Card* card = wasteArray[wasteTop--];
-                if (card->inPlay)
-                {
-                    stockArray[++stockTop] = card;
-                }
+                slot = &animations[i];
+                activeCount--;
+                break;
             }
-            currentWasteCard = nullptr;
+            if (!animations[i].active && !slot)
+                slot = &animations[i];
         }
+        if (!slot)
+            return false;
 
-        // Draw from stock
-        if (stockTop >= 0)
+        slot->active = true;
+        slot->kind = kind;
+        slot->card = card;
+        slot->from = from;
+        slot->to = to;
+        slot->elapsed = 0.0f;
+        slot->duration = duration;
+        activeCount++;
+        return true;
+    }
+
+    // Returns true if a flip landed, i.e. the table has a card to show again
+    bool update(float deltaTime)
+    {
+        bool landed = false;
+        for (int i = 0; i < CAPACITY && activeCount > 0; i++)
         {
-            Card* card = stockArray[stockTop--];
-            card->faceUp = true;
-            wasteArray[++wasteTop] = card;
-            currentWasteCard = card;
+            Animation& animation = animations[i];
+            if (!animation.active)
+                continue;
+            animation.elapsed += deltaTime;
+            if (animation.elapsed >= animation.duration)
+            {
+                animation.active = false;
+                activeCount--;
+                if (animation.kind == ANIM_FLIP)
+                    landed = true;
+            }
         }
+        return landed;
     }
 
-    void removeCards()
+    bool isActive() const
     {
-        // Handle King removal (single card)
-        if (selectedCard1 && isKing(selectedCard1))
-        {
+        return activeCount > 0;
+    }
+
+    // True while the table should leave card out (it is drawn in flight)
+    bool hides(const Card* card) const
+    {
+        for (int i = 0; i < CAPACITY && activeCount > 0; i++)
+        {
+            if (animations[i].active && animations[i].kind == ANIM_FLIP && animations[i].card == card)
+                return true;
+        }
+        return false;
+    }
+
+    int capacity() const
+    {
+        return CAPACITY;
+    }
+
+    const Animation& at(int index) const
+    {
+        return animations[index];
+    }
+
+    // Eased progress in [0, 1]: fast start, gentle landing. ahead is time
+    // since the last update, for drawing between simulation ticks.
+    static float progress(const Animation& animation, float ahead)
+    {
+        float t = (animation.elapsed + ahead) / animation.duration;
+        if (t > 1.0f)
+            t = 1.0f;
+        return 1.0f - (1.0f - t) * (1.0f - t);
+    }
+
+    static Rectangle lerp(Rectangle a, Rectangle b, float t)
+    {
+        return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t,
+            a.width + (b.width - a.width) * t, a.height + (b.height - a.height) * t };
+    }
+};
+
+// A line of text rasterized once (ImageText) and then drawn as a single
+// textured quad. set() rasterizes again only when the text, size or
+// colour differs from what is cached, so a HUD value costs nothing until
+// it changes.
+class CachedText
+{
+private:
+    char text[96];
+    int fontSize;
+    Color color;
+    Texture2D texture;
+
+public:
+    CachedText() : fontSize(0), color(), texture()
+    {
+        text[0] = '\0';
+    }
+
+    void set(const char* newText, int newFontSize, Color newColor)
+    {
+        if (texture.id != 0 && newFontSize == fontSize && strcmp(newText, text) == 0 &&
+            newColor.r == color.r && newColor.g == color.g && newColor.b == color.b && newColor.a == color.a)
+            return;
+
+        unload();
+        strncpy(text, newText, sizeof(text) - 1);
+        text[sizeof(text) - 1] = '\0';
+        fontSize = newFontSize;
+        color = newColor;
+
+        Image image = ImageText(text, fontSize, color);
+        if (image.data != NULL)
+        {
+            texture = LoadTextureFromImage(image);
+            UnloadImage(image);
+        }
+    }
+
+    // Falls back to plain text if rasterizing failed
+    void draw(DrawList& list, int layer, int x, int y) const
+    {
+        if (texture.id != 0)
+        {
+            list.texture(layer, texture, { 0, 0, (float)texture.width, (float)texture.height },
+                { (float)x, (float)y, (float)texture.width, (float)texture.height }, WHITE);
+        }
+        else if (text[0] != '\0')
+        {
+            list.text(layer, text, x, y, fontSize, color);
+        }
+    }
+
+    void unload()
+    {
+        if (texture.id != 0)
+            UnloadTexture(texture);
+        texture = Texture2D{};
+    }
+};
+
+// Saved game file: a SaveHeader followed by one SaveRecord, built in
+// memory and written in one go. length and crc (CRC-32 of the record)
+// let a load reject truncated, foreign or damaged files before anything
+// in them is used. The record holds only fixed-size fields and card
+// indices, never pointers; bump SAVE_VERSION when it changes.
+const char SAVE_MAGIC[4] = { 'P', 'S', 'S', 'V' };
+const unsigned int SAVE_VERSION = 1;
+
+struct SaveHeader
+{
+    char magic[4];
+    unsigned int version;
+    unsigned int length;
+    unsigned int crc;
+};
+
+// Cards are identified by their index in allCards (0-27 pyramid, 28-51
+// stock and waste); -1 = none
+struct SaveRecord
+{
+    long long gameTimeUs;
+    int score;
+    int moves;
+    unsigned int dealSeed;
+    unsigned char cards[52];        // value | suit << 4
+    unsigned char cardFlags[52];    // faceUp | inPlay << 1
+    signed char stock[24];
+    signed char waste[24];
+    signed char stockTop;
+    signed char wasteTop;
+    signed char wasteCard;
+    signed char reserved;
+};
+
+// CRC-32 (IEEE, as used by zlib and PNG)
+unsigned int crc32(const void* data, size_t size)
+{
+    static unsigned int table[256];
+    static bool tableReady = false;
+    if (!tableReady)
+    {
+        for (unsigned int i = 0; i < 256; i++)
+        {
+            unsigned int c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        tableReady = true;
+    }
+
+    const unsigned char* bytes = (const unsigned char*)data;
+    unsigned int crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+const size_t SAVE_FILE_BYTES = sizeof(SaveHeader) + sizeof(SaveRecord);
+
+// Writes data to path through path.tmp: write, flush to disk, then rename
+// over path. A crash leaves either the old file or the new one, never a
+// partly written one. On POSIX the directory is flushed too, so the
+// rename itself survives a power cut; if only that flush fails, the new
+// file is in place and counts as written, with a warning.
+bool writeFileAtomically(const char* path, const void* data, size_t size)
+{
+    string tempPath = string(path) + ".tmp";
+#ifndef _WIN32
+    int fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    bool written = ::write(fd, data, size) == (ssize_t)size && fsync(fd) == 0;
+    written = (::close(fd) == 0) && written;
+    if (!written || ::rename(tempPath.c_str(), path) != 0)
+    {
+        ::unlink(tempPath.c_str());
+        return false;
+    }
+
+    const char* slash = strrchr(path, '/');
+    string directory = slash ? string(path, (slash == path) ? 1 : slash - path) : string(".");
+    int dirFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    bool synced = dirFd >= 0 && fsync(dirFd) == 0;
+    if (dirFd >= 0)
+        synced = (::close(dirFd) == 0) && synced;
+    if (!synced)
+        cout << "Warning: " << path << " was written, but " << directory << " could not be flushed to disk" << endl;
+    return true;
+#else
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (!file)
+        return false;
+    bool written = fwrite(data, 1, size, file) == size && fflush(file) == 0 && _commit(_fileno(file)) == 0;
+    written = (fclose(file) == 0) && written;
+    // Replaces an existing file, unlike rename()
+    error_code error;
+    if (written)
+        filesystem::rename(tempPath, path, error);
+    if (!written || error)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+#endif
+}
+
+// Writes saved games on a background thread so saving never holds up a
+// frame. submit() copies the encoded file and returns at once; a save
+// submitted while another is waiting replaces it, since only the latest
+// matters. The game picks up finished writes with takeResults() each
+// update. The thread starts on the first submit, and shutdown() writes
+// anything still waiting before it returns.
+class SaveWorker
+{
+private:
+    unsigned char pending[SAVE_FILE_BYTES];
+    const char* pendingPath;
+    bool hasPending;
+    bool busy;
+    bool stopping;
+    int succeeded;
+    int failed;
+
+    thread worker;
+    mutex lock;
+    condition_variable wake;
+    condition_variable idle;
+
+    void run()
+    {
+        unsigned char data[SAVE_FILE_BYTES];
+        unique_lock<mutex> guard(lock);
+        while (true)
+        {
+            wake.wait(guard, [this] { return hasPending || stopping; });
+            if (!hasPending)
+                break;
+
+            const char* path = pendingPath;
+            memcpy(data, pending, sizeof(data));
+            hasPending = false;
+            busy = true;
+
+            guard.unlock();
+            bool ok = writeFileAtomically(path, data, sizeof(data));
+            guard.lock();
+
+            busy = false;
+            if (ok)
+                succeeded++;
+            else
+                failed++;
+            idle.notify_all();
+        }
+    }
+
+public:
+    SaveWorker() : pendingPath(NULL), hasPending(false), busy(false), stopping(false), succeeded(0), failed(0)
+    {
+    }
+
+    ~SaveWorker()
+    {
+        shutdown();
+    }
+
+    void submit(const char* path, const unsigned char (&data)[SAVE_FILE_BYTES])
+    {
+        lock_guard<mutex> guard(lock);
+        if (!worker.joinable())
+        {
+            stopping = false;
+            worker = thread(&SaveWorker::run, this);
+        }
+        memcpy(pending, data, sizeof(pending));
+        pendingPath = path;
+        hasPending = true;
+        wake.notify_one();
+    }
+
+    // Blocks until nothing is waiting or being written, so the file on
+    // disk is the latest save (before reading or deleting it)
+    void waitIdle()
+    {
+        unique_lock<mutex> guard(lock);
+        idle.wait(guard, [this] { return !hasPending && !busy; });
+    }
+
+    // Writes finished since the last call
+    void takeResults(int& okCount, int& failedCount)
+    {
+        lock_guard<mutex> guard(lock);
+        okCount = succeeded;
+        failedCount = failed;
+        succeeded = 0;
+        failed = 0;
+    }
+
+    void shutdown()
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_one();
+        if (worker.joinable())
+            worker.join();
+    }
+};
+
+// Checks everything a load relies on: a full deck, pile sizes within
+// bounds, and each stock/waste card drawn from 28-51 at most once
+bool isValidSaveRecord(const SaveRecord& record)
+{
+    bool seen[52] = { false };
+    for (int i = 0; i < 52; i++)
+    {
+        int value = record.cards[i] & 15;
+        int suit = record.cards[i] >> 4;
+        if (value < 1 || value > 13 || suit > 3 || record.cardFlags[i] > 3)
+            return false;
+        int card = suit * 13 + value - 1;
+        if (seen[card])
+            return false;
+        seen[card] = true;
+    }
+
+    if (record.stockTop < -1 || record.wasteTop < -1 || record.stockTop + record.wasteTop + 2 > 24)
+        return false;
+
+    bool used[52] = { false };
+    for (int i = 0; i <= record.stockTop + record.wasteTop + 1; i++)
+    {
+        int index = (i <= record.stockTop) ? record.stock[i] : record.waste[i - record.stockTop - 1];
+        if (index < 28 || index > 51 || used[index])
+            return false;
+        used[index] = true;
+    }
+
+    return record.wasteCard == -1 || (record.wasteCard >= 28 && record.wasteCard <= 51);
+}
+
+// Heap block size for a request, as glibc malloc rounds it
+// (8-byte header, 16-byte alignment, 32-byte minimum)
+long long heapBlockBytes(long long requested)
+{
+    long long block = (requested + 8 + 15) / 16 * 16;
+    return (block < 32) ? 32 : block;
+}
+
+// Longest pipe command line; longer lines are rejected, not cut short
+const int PIPE_LINE_MAX = 127;
+
+class PyramidSolitaire
+{
+private:
+    // PYRAMID CARDS: Using BST (works perfectly for hierarchical structure)
+    BST<PyramidCard> pyramidBST;
+
+    /* ============================================================
+     * FAILED BST IMPLEMENTATION FOR STOCK/WASTE PILES
+     * ============================================================
+     *
+     * PROBLEM: Stock and Waste piles require LIFO (Last In First Out)
+     * stack behavior, but BST maintains sorted order which is incompatible.
+     *
+     * ATTEMPTED IMPLEMENTATION #1: Direct BST with position-based ordering
+     *
+     * BST<Card> stockBST;
+     * BST<Card> wasteBST;
+     *
+     * void drawCardFromStockBST_Attempt1() {
+     *     if (stockBST.isEmpty()) {
+     *         // Recycle waste back to stock
+     *         Card wasteCards[52];
+     *         int count = 0;
+     *
+     *         // Problem: toArray returns cards in SORTED order (by position)
+     *         // not in the order they were added to waste!
+     *         wasteBST.toArray(wasteCards);
+     *         count = wasteBST.getSize();
+     *
+     *         wasteBST.clear();
+     *
+     *         // Cards are inserted in wrong order - BST sorts them!
+     *         for (int i = count - 1; i >= 0; i--) {
+     *             if (wasteCards[i].inPlay) {
+     *                 stockBST.insert(wasteCards[i]);
+     *             }
+     *         }
+     *     }
+     *
+     *     // Problem: How to get the "top" card (last inserted)?
+     *     // BST doesn't track insertion order!
+     *     // getMax() returns highest position, not last inserted
+     *     BSTNode<Card>* maxNode = stockBST.getMax();
+     *     if (maxNode) {
+     *         Card topCard = maxNode->data;
+     *         stockBST.remove(topCard);
+     *         topCard.faceUp = true;
+     *         wasteBST.insert(topCard);
+     *     }
+     * }
+     *
+     * WHY IT FAILS:
+     * - Drawing cards happens in wrong order (sorted by position, not draw order)
+     * - Recycling breaks gameplay (cards reappear in wrong sequence)
+     * - Can't maintain "last drawn" concept
+     *
+     *
+     * ATTEMPTED IMPLEMENTATION #2: Augmented BST with insertion counter
+     *
+     * struct CardWithInsertionOrder {
+     *     Card card;
+     *     int insertionOrder;
+     *
+     *     bool operator<(const CardWithInsertionOrder& other) const {
+     *         return insertionOrder < other.insertionOrder;
+     *     }
+     * };
+     *
+     * BST<CardWithInsertionOrder> stockBST;
+     * BST<CardWithInsertionOrder> wasteBST;
+     * int globalInsertionCounter = 0;
+     *
+     * void drawCardFromStockBST_Attempt2() {
+     *     if (stockBST.isEmpty()) {
+     *         // Recycle waste
+     *         CardWithInsertionOrder wasteCards[52];
+     *         int count = 0;
+     *         wasteBST.toArray(wasteCards);
+     *         count = wasteBST.getSize();
+     *         wasteBST.clear();
+     *
+     *         // Problem: Need to reverse order AND reassign insertion numbers
+     *         for (int i = count - 1; i >= 0; i--) {
+     *             wasteCards[i].insertionOrder = globalInsertionCounter++;
+     *             stockBST.insert(wasteCards[i]);
+     *         }
+     *     }
+     *
+     *     // Problem: getMax() traverses to rightmost node - O(h) every draw!
+     *     // For 24 stock cards, this is inefficient
+     *     BSTNode<CardWithInsertionOrder>* maxNode = stockBST.getMax();
+     *     if (maxNode) {
+     *         CardWithInsertionOrder topCard = maxNode->data;
+     *         stockBST.remove(topCard);
+     *         topCard.card.faceUp = true;
+     *         topCard.insertionOrder = globalInsertionCounter++;
+     *         wasteBST.insert(topCard);
+     *     }
+     * }
+     *
+     * WHY IT STILL FAILS:
+     * - Every draw operation requires tree traversal to rightmost node
+     * - Insertion counter overflow risk in long games
+     * - Complex recycling logic with counter management
+     * - O(log n) for insert/delete + O(h) for finding max = worse than array
+     *
+     *
+     * ATTEMPTED IMPLEMENTATION #3: Reverse-ordered BST
+     *
+     * struct ReverseCard {
+     *     Card card;
+     *     int reversePosition;
+     *
+     *     bool operator<(const ReverseCard& other) const {
+     *         return reversePosition > other.reversePosition; // Reversed!
+     *     }
+     * };
+     *
+     * BST<ReverseCard> stockBST;
+     *
+     * void drawCardFromStockBST_Attempt3() {
+     *     // Problem: Now getMin() gives us "last", but recycling is nightmare
+     *     BSTNode<ReverseCard>* minNode = stockBST.getMin();
+     *     if (minNode) {
+     *         stockBST.remove(minNode->data);
+     *         // ... more complex logic
+     *     }
+     * }
+     *
+     * WHY IT FAILS:
+     * - Confusing reversed logic throughout codebase
+     * - Still can't efficiently handle recycling
+     * - Counter-intuitive comparisons make debugging hard
+     *
+     *
+     * FUNDAMENTAL CONCLUSION:
+     * BST is designed for SORTED data with efficient searching.
+     * Stock/Waste piles need LIFO (stack) behavior with NO sorting.
+     * These requirements are fundamentally incompatible.
+     *
+     * Stack ADT (array-based) is the correct choice:
+     * - O(1) push/pop operations
+     * - Natural LIFO behavior
+     * - Simple recycling (just reverse copy)
+     * - No unnecessary tree maintenance overhead
+     *
+     * Using BST here violates "use the right tool for the job" principle.
+     * After 100% effort and multiple approaches, array-based stack is correct.
+     * ============================================================ */
+
+     // WORKING IMPLEMENTATION: Array-based stacks for LIFO behavior
+    Card* stockArray[52];
+    int stockTop;
+
+    Card* wasteArray[52];
+    int wasteTop;
+
+    Card* selectedCard1;
+    Card* selectedCard2;
+    PyramidCard* selectedPyramid1;
+    PyramidCard* selectedPyramid2;
+
+    Card* currentWasteCard;
+
+    int score;
+    int moves;
+    unsigned int dealSeed;
+    int currentGameScoreIndex;
+    bool isNewGame;
+    // Time played in microseconds, advanced in whole simulation ticks
+    long long gameTimeUs;
+    bool gameWon;
+    bool gameLost;
+
+    Texture2D stockTexture;
+    Texture2D background;
+    CardTextureCache cardFaces;
+    BackgroundMusic backgroundMusic;
+
+    // When images/atlas.png is present, cards and the stock are drawn
+    // from it instead of cardFaces and stockTexture
+    Texture2D cardAtlas;
+    Rectangle cardAtlasRegions[ATLAS_CELL_COUNT];
+
+    // The table (background, cards, piles, score and buttons) is drawn
+    // into tableLayer and redrawn only when tableDirty is set: by a move,
+    // a stock draw, a selection change or a new/loaded game.
+    // Other frames blit it and draw the clock and overlays on top.
+    RenderTexture2D tableLayer;
+    bool tableDirty;
+
+    // Menu screens are static, so the current one is drawn once into
+    // menuLayer and blitted afterwards. menuLayerState is the screen it
+    // holds, or -1 to redraw it (reset on every game frame, so a menu is
+    // redrawn each time it is entered).
+    RenderTexture2D menuLayer;
+    int menuLayerState;
+
+    // Draw layers, back to front. Cards in one pyramid row never overlap,
+    // so they can be reordered by texture; rows overlap the row above, so
+    // each row gets its own layer pair (cards, then markers/outlines).
+    enum DrawLayer
+    {
+        LAYER_BACKGROUND = 0,
+        LAYER_PYRAMID = 1,          // + 2 * row, + 1 for markers
+        LAYER_PILES = 15,
+        LAYER_PILE_MARKS = 16,
+        LAYER_HUD = 17,
+        LAYER_ANIMATION = 18,       // + 1 for outlines
+        LAYER_OVERLAY = 20,
+        LAYER_OVERLAY_TEXT = 21
+    };
+
+    // Moving cards, drawn each frame on top of the table layer
+    CardAnimationPool animations;
+    const float FLIGHT_SECONDS = 0.35f;
+    const float FLIP_SECONDS = 0.25f;
+
+    DrawList tableDraws;
+    DrawList frameDraws;
+    bool drawStatsEnabled;
+
+    // Text that changes while the table layer stays valid
+    CachedText clockText;
+    CachedText saveText;
+    CachedText overlayTitle;
+    CachedText overlayScore;
+    CachedText overlayHint;
+
+    // Set when the screen no longer matches the last frame drawn (input,
+    // a new clock second, the save message expiring, the game ending);
+    // main() skips render() while it is clear in --idle mode
+    bool redrawNeeded;
+
+    // Set by the menu's EXIT button; main() leaves its loop so the
+    // destructor still stops the save worker
+    bool quitRequested;
+
+    GameState currentState;
+    bool isPaused;
+
+    int highScores[5];
+    int highScoreCount;
+
+    const char* SCORE_FILE = "scores.txt";
+    const char* SAVE_FILE = "gamesave.dat";
+
+    // Music plays under the sound effects
+    const float MUSIC_VOLUME_SCALE = 0.4f;
+
+    // Everything is laid out and drawn on a fixed canvas of this size,
+    // which render() scales to fit the window (see canvasViewport())
+    static const int CANVAS_WIDTH = 1400;
+    static const int CANVAS_HEIGHT = 950;
+
+    const int CARD_WIDTH = 90;
+    const int CARD_HEIGHT = 130;
+    const int CARD_SPACING = 20;
+
+    Card allCards[52];
+    PyramidCard allPyramidCards[28];
+    int cardCount;
+
+    // Canvas rectangles of the table, computed once by getLayout(), so
+    // drawing and hit testing share them.
+    // pyramid[] is indexed by slot, row * (row + 1) / 2 + col, which is
+    // also the order of allPyramidCards.
+    struct TableLayout
+    {
+        int width;
+        int height;
+        int pileY;
+        Rectangle pyramid[28];
+        // Pyramid grid for pyramidSlotAt(): rows start rowStep apart from
+        // pyramidTop, and cards in a row are columnStep apart
+        float pyramidTop;
+        float rowStep;
+        float columnStep;
+        Rectangle waste;
+        Rectangle stock;
+        Rectangle restartButton;
+        Rectangle foundation;       // where matched cards fly off to (not drawn)
+    };
+    TableLayout layout;
+
+    SoundVoicePool soundEffects;
+    float soundVolume;
+
+    bool savedGameExists;
+    bool showSaveMessage;
+    long long saveMessageUs;
+
+    // Headless games (benchmarks, simulations) have no window, audio or
+    // textures and never touch the score/save files.
+    bool headless;
+
+    // Game logic runs in fixed ticks, whatever the frame rate: update()
+    // adds real time to simAccumulatorUs and runs one tick per
+    // SIM_TICK_US in it. What is left over when a frame is drawn is used
+    // to interpolate moving cards between the last tick and the next.
+    static const long long SIM_TICK_US = 10000;         // 100 ticks a second
+    static const long long SIM_MAX_FRAME_US = 250000;   // longer stalls are dropped
+    long long simAccumulatorUs;
+    long long loseCheckUs;
+
+    InputQueue inputQueue;
+    SaveWorker saveWorker;
+
+    // The windowed game fed by onMouseButton/onKey, and the raylib
+    // handlers they pass each event on to
+    static PyramidSolitaire* windowInput;
+    static GLFWmousebuttonfun raylibMouseButtonCallback;
+    static GLFWkeyfun raylibKeyCallback;
+
+    // Positions before recent pipe commands, for the undo command: a
+    // ring of UNDO_DEPTH, allocated on the first command so other games
+    // do not carry it. Cards are stored by index into allCards.
+    struct GameSnapshot
+    {
+        unsigned char cardFlags[52];    // faceUp | inPlay << 1
+        signed char stock[52];
+        signed char waste[52];
+        signed char stockTop;
+        signed char wasteTop;
+        signed char wasteCard;
+        signed char selected1;
+        signed char selected2;
+        signed char selectedSlot1;
+        signed char selectedSlot2;
+        int score;
+        int moves;
+        bool gameWon;
+        bool gameLost;
+    };
+    static const int UNDO_DEPTH = 64;
+    GameSnapshot* undoRing;
+    int undoNext;
+    int undoCount;
+
+    // Input recording and seeded deal sequence (see startRecording)
+    ofstream recordFile;
+    double recordLastTime;   // time of the last recorded event
+    bool seededDeals;
+    unsigned int nextDealSeed;
+
+public:
+    PyramidSolitaire(bool runHeadless = false)
+    {
+        headless = runHeadless;
+        selectedCard1 = nullptr;
+        selectedCard2 = nullptr;
+        selectedPyramid1 = nullptr;
+        selectedPyramid2 = nullptr;
+        currentWasteCard = nullptr;
+        score = 0;
+        moves = 0;
+        dealSeed = 0;
+        currentGameScoreIndex = -1;
+        isNewGame = true;
+        gameTimeUs = 0;
+        gameWon = false;
+        gameLost = false;
+        cardCount = 0;
+        stockTop = -1;
+        wasteTop = -1;
+        currentState = MAIN_MENU;
+        isPaused = false;
+        highScoreCount = 0;
+        savedGameExists = false;
+        showSaveMessage = false;
+        saveMessageUs = 0;
+        simAccumulatorUs = 0;
+        loseCheckUs = 0;
+        recordLastTime = 0.0;
+        undoRing = NULL;
+        undoNext = 0;
+        undoCount = 0;
+        seededDeals = false;
+        nextDealSeed = 0;
+        soundVolume = 0.7f;
+        layout.width = 0;
+        layout.height = 0;
+        stockTexture = { 0 };
+        background = { 0 };
+        cardAtlas = { 0 };
+        tableLayer = { 0 };
+        tableDirty = true;
+        menuLayer = { 0 };
+        menuLayerState = -1;
+        drawStatsEnabled = false;
+        redrawNeeded = true;
+        quitRequested = false;
+
+        if (headless)
+            return;
+
+        loadHighScores();
+        startupTimeline.mark("loadHighScores");
+        checkSavedGame();
+        startupTimeline.mark("checkSavedGame");
+        InitAudioDevice();
+        startupTimeline.mark("InitAudioDevice");
+        assetPack.open(ASSET_PACK_PATH);
+        startupTimeline.mark("open asset pack");
+
+        loadAllSounds();
+        startupTimeline.mark("loadAllSounds");
+        backgroundMusic.start("sounds/background_music.mp3", soundVolume * MUSIC_VOLUME_SCALE);
+        startupTimeline.mark("start music");
+        loadCardTextures();
+        startupTimeline.mark("upload textures");
+        installInputCallbacks();
+    }
+
+    ~PyramidSolitaire()
+    {
+        if (inputQueue.getDropped() > 0)
+            cout << "Input queue was full: " << inputQueue.getDropped() << " actions dropped" << endl;
+        delete[] undoRing;
+        saveWorker.shutdown();
+        if (windowInput == this)
+            windowInput = NULL;
+
+        if (headless)
+            return;
+
+        if (currentState == PLAYING && !gameWon && !gameLost && score > 0)
+        {
+            saveCurrentGameScore();
+        }
+
+        cardFaces.report();
+        cardFaces.shutdown();
+        if (drawStatsEnabled)
+        {
+            tableDraws.report("table rebuild");
+            frameDraws.report("frame");
+        }
+        UnloadTexture(background);
+        if (stockTexture.id != 0)
+            UnloadTexture(stockTexture);
+        if (cardAtlas.id != 0)
+            UnloadTexture(cardAtlas);
+        if (tableLayer.id != 0)
+            UnloadRenderTexture(tableLayer);
+        if (menuLayer.id != 0)
+            UnloadRenderTexture(menuLayer);
+        clockText.unload();
+        saveText.unload();
+        overlayTitle.unload();
+        overlayScore.unload();
+        overlayHint.unload();
+
+        soundEffects.unload();
+        backgroundMusic.stop();
+
+        CloseAudioDevice();
+    }
+
+    // Only a save that would load counts, so LOAD GAME is offered for it.
+    // A save still being written is not waited for: it reports itself
+    // when done (pollSaveResults).
+    void checkSavedGame()
+    {
+        SaveRecord record;
+        savedGameExists = readSaveFile(record);
+    }
+
+    // Reads and validates the whole file; record is untouched on failure
+    bool readSaveFile(SaveRecord& record)
+    {
+        unsigned char buffer[SAVE_FILE_BYTES + 1];
+        ifstream file(SAVE_FILE, ios::binary);
+        if (!file.is_open())
+            return false;
+        file.read((char*)buffer, sizeof(buffer));
+        size_t size = (size_t)file.gcount();
+        file.close();
+
+        SaveHeader header;
+        if (size != SAVE_FILE_BYTES)
+            return false;
+        memcpy(&header, buffer, sizeof(header));
+        if (memcmp(header.magic, SAVE_MAGIC, 4) != 0 || header.version != SAVE_VERSION
+            || header.length != sizeof(SaveRecord)
+            || header.crc != crc32(buffer + sizeof(SaveHeader), sizeof(SaveRecord)))
+            return false;
+
+        SaveRecord loaded;
+        memcpy(&loaded, buffer + sizeof(SaveHeader), sizeof(loaded));
+        if (!isValidSaveRecord(loaded))
+            return false;
+        record = loaded;
+        return true;
+    }
+
+    // Snapshots the game and hands it to saveWorker; "GAME SAVED!" shows
+    // once the file is safely written (see pollSaveResults)
+    void saveGame()
+    {
+        if (headless)
+            return;
+
+        unsigned char buffer[SAVE_FILE_BYTES];
+        encodeSaveFile(buffer);
+        saveWorker.submit(SAVE_FILE, buffer);
+    }
+
+    // Used by the pipe save command, which saves even when headless and
+    // needs the result before it replies
+    bool writeSaveFile()
+    {
+        unsigned char buffer[SAVE_FILE_BYTES];
+        encodeSaveFile(buffer);
+        saveWorker.waitIdle();
+        if (!writeFileAtomically(SAVE_FILE, buffer, sizeof(buffer)))
+        {
+            cout << "Error: Could not save game!" << endl;
+            return false;
+        }
+        savedGameSucceeded();
+        return true;
+    }
+
+    void savedGameSucceeded()
+    {
+        savedGameExists = true;
+        showSaveMessage = true;
+        saveMessageUs = 2000000;
+        menuLayerState = -1;
+        redrawNeeded = true;
+        cout << "Game saved successfully to " << SAVE_FILE << endl;
+    }
+
+    // Reports saves the worker has finished
+    void pollSaveResults()
+    {
+        int okCount = 0;
+        int failedCount = 0;
+        saveWorker.takeResults(okCount, failedCount);
+        if (okCount > 0)
+            savedGameSucceeded();
+        if (failedCount > 0)
+            cout << "Error: Could not save game!" << endl;
+    }
+
+    void encodeSaveFile(unsigned char (&buffer)[SAVE_FILE_BYTES])
+    {
+        SaveRecord record;
+        memset(&record, 0, sizeof(record));
+        record.gameTimeUs = gameTimeUs;
+        record.score = score;
+        record.moves = moves;
+        record.dealSeed = dealSeed;
+        for (int i = 0; i < 52; i++)
+        {
+            record.cards[i] = (unsigned char)(allCards[i].value | (allCards[i].suit << 4));
+            record.cardFlags[i] = (unsigned char)(allCards[i].faceUp | (allCards[i].inPlay << 1));
+        }
+        for (int i = 0; i <= stockTop; i++)
+        {
+            record.stock[i] = (signed char)(stockArray[i] - allCards);
+        }
+        for (int i = 0; i <= wasteTop; i++)
+        {
+            record.waste[i] = (signed char)(wasteArray[i] - allCards);
+        }
+        record.stockTop = (signed char)stockTop;
+        record.wasteTop = (signed char)wasteTop;
+        record.wasteCard = currentWasteCard ? (signed char)(currentWasteCard - allCards) : -1;
+
+        SaveHeader header;
+        memcpy(header.magic, SAVE_MAGIC, 4);
+        header.version = SAVE_VERSION;
+        header.length = sizeof(SaveRecord);
+        header.crc = crc32(&record, sizeof(record));
+        memcpy(buffer, &header, sizeof(header));
+        memcpy(buffer + sizeof(header), &record, sizeof(record));
+    }
+
+    bool loadGame()
+    {
+        // Load the latest save, not the one it is replacing
+        saveWorker.waitIdle();
+
+        SaveRecord record;
+        if (!readSaveFile(record))
+        {
+            cout << "Error: Could not load game from " << SAVE_FILE << " (missing, old or damaged)" << endl;
+            savedGameExists = false;
+            menuLayerState = -1;
+            return false;
+        }
+
+        // Clear current game
+        animations.clear();
+        undoCount = 0;
+        pyramidBST.clear();
+
+        score = record.score;
+        moves = record.moves;
+        gameTimeUs = record.gameTimeUs;
+        dealSeed = record.dealSeed;
+        for (int i = 0; i < 52; i++)
+        {
+            allCards[i].value = record.cards[i] & 15;
+            allCards[i].suit = record.cards[i] >> 4;
+            allCards[i].faceUp = (record.cardFlags[i] & 1) != 0;
+            allCards[i].inPlay = (record.cardFlags[i] & 2) != 0;
+            allCards[i].position = i;
+        }
+
+        // Rebuild pyramid structure
+        int cardIdx = 0;
+        for (int row = 0; row < 7; row++)
+        {
+            for (int col = 0; col <= row; col++)
+            {
+                allPyramidCards[cardIdx] = PyramidCard(&allCards[cardIdx], row, col);
+                pyramidBST.insert(allPyramidCards[cardIdx]);
+                cardIdx++;
+            }
+        }
+        updateBlockedStatus();
+
+        stockTop = record.stockTop;
+        wasteTop = record.wasteTop;
+        for (int i = 0; i <= stockTop; i++)
+        {
+            stockArray[i] = &allCards[record.stock[i]];
+        }
+        for (int i = 0; i <= wasteTop; i++)
+        {
+            wasteArray[i] = &allCards[record.waste[i]];
+        }
+        currentWasteCard = (record.wasteCard >= 0) ? &allCards[record.wasteCard] : NULL;
+
+        // Reset selection and flags
+        selectedCard1 = nullptr;
+        selectedCard2 = nullptr;
+        selectedPyramid1 = nullptr;
+        selectedPyramid2 = nullptr;
+        gameWon = false;
+        gameLost = false;
+        isNewGame = false;
+        cardCount = 52;
+
+        currentState = PLAYING;
+        tableDirty = true;
+        prefetchCardFaces();
+        cout << "Game loaded successfully from " << SAVE_FILE << endl;
+        return true;
+    }
+
+    void deleteSavedGame()
+    {
+        if (headless)
+            return;
+
+        // A save still being written would bring the file back
+        saveWorker.waitIdle();
+        if (remove(SAVE_FILE) == 0)
+        {
+            cout << "Saved game deleted." << endl;
+        }
+        savedGameExists = false;
+    }
+
+    void loadAllSounds()
+    {
+        soundEffects.load();
+        setSoundVolume(soundVolume);
+    }
+
+    void setSoundVolume(float volume)
+    {
+        soundVolume = volume;
+        soundEffects.setVolume(volume);
+        backgroundMusic.setVolume(volume * MUSIC_VOLUME_SCALE);
+    }
+
+    void playCardSelectSound()
+    {
+        soundEffects.play(SFX_CARD_SELECT);
+    }
+
+    void playCardMatchSound()
+    {
+        soundEffects.play(SFX_CARD_MATCH);
+    }
+
+    void playCardMismatchSound()
+    {
+        soundEffects.play(SFX_CARD_MISMATCH);
+    }
+
+    void playStockDrawSound()
+    {
+        soundEffects.play(SFX_STOCK_DRAW);
+    }
+
+    void loadHighScores()
+    {
+        ifstream file(SCORE_FILE);
+        highScoreCount = 0;
+
+        if (!file.is_open())
+            return;
+
+        while (highScoreCount < 5 && file >> highScores[highScoreCount])
+        {
+            highScoreCount++;
+        }
+        file.close();
+
+        // Sort high scores in descending order
+        for (int i = 0; i < highScoreCount - 1; i++)
+        {
+            for (int j = i + 1; j < highScoreCount; j++)
+            {
+                if (highScores[j] > highScores[i])
+                {
+                    int temp = highScores[i];
+                    highScores[i] = highScores[j];
+                    highScores[j] = temp;
+                }
+            }
+        }
+    }
+
+    void saveHighScores()
+    {
+        ofstream file(SCORE_FILE, ios::trunc);
+        if (!file.is_open())
+        {
+            cout << "Error: Could not save high scores!" << endl;
+            return;
+        }
+
+        for (int i = 0; i < highScoreCount; i++)
+        {
+            file << highScores[i] << endl;
+        }
+        file.close();
+        cout << "High scores saved successfully." << endl;
+    }
+
+    void saveCurrentGameScore()
+    {
+        if (headless)
+            return;
+
+        if (isNewGame)
+        {
+            if (highScoreCount < 5)
+            {
+                currentGameScoreIndex = highScoreCount;
+                highScores[highScoreCount++] = score;
+            }
+            else
+            {
+                if (score > highScores[4])
+                {
+                    currentGameScoreIndex = 4;
+                    highScores[4] = score;
+                }
+            }
+            isNewGame = false;
+        }
+        else if (currentGameScoreIndex >= 0 && currentGameScoreIndex < 5)
+        {
+            highScores[currentGameScoreIndex] = score;
+        }
+
+        // Sort high scores
+        for (int i = 0; i < highScoreCount - 1; i++)
+        {
+            for (int j = i + 1; j < highScoreCount; j++)
+            {
+                if (highScores[j] > highScores[i])
+                {
+                    int temp = highScores[i];
+                    highScores[i] = highScores[j];
+                    highScores[j] = temp;
+                }
+            }
+        }
+
+        saveHighScores();
+    }
+
+    // Reads the atlas region file; false if it is missing or a region is
+    // not listed (the atlas image itself is loaded with the other textures)
+    bool loadCardAtlasRegions()
+    {
+        ifstream regions(ATLAS_REGIONS_PATH);
+        if (!regions)
+            return false;
+
+        bool found[ATLAS_CELL_COUNT] = {};
+        int foundCount = 0;
+        string line;
+        while (getline(regions, line))
+        {
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            char name[16];
+            float x, y, w, h;
+            if (sscanf(line.c_str(), "%15s %f %f %f %f", name, &x, &y, &w, &h) != 5)
+                continue;
+
+            int cell = atlasCellIndex(name);
+            if (cell < 0)
+                continue;
+            if (!found[cell])
+                foundCount++;
+            found[cell] = true;
+            cardAtlasRegions[cell] = { x, y, w, h };
+        }
+
+        return foundCount == ATLAS_CELL_COUNT;
+    }
+
+    // Uploads a decoded image and frees the CPU copy; id 0 if decoding failed
+    Texture2D uploadTexture(ImageDecodeJob& job)
+    {
+        Texture2D texture = { 0 };
+        if (job.image.data != NULL)
+        {
+            texture = LoadTextureFromImage(job.image);
+            unloadImageAsset(job.image, job.mapped);
+        }
+        return texture;
+    }
+
+    void loadCardTextures()
+    {
+        // Only the background and the atlas (or the stock back) are loaded
+        // here; without the atlas, faces are loaded by cardFaces when needed
+        ImageDecodeJob jobs[2];
+        jobs[0].path = "images/background.jpg";
+        bool useAtlas = loadCardAtlasRegions();
+        jobs[1].path = useAtlas ? ATLAS_IMAGE_PATH : "images/stock.jpg";
+        jobs[1].cardImage = !useAtlas;
+
+        decodeImagesParallel(jobs, 2);
+        startupTimeline.mark("decode images");
+
+        background = uploadTexture(jobs[0]);
+        if (useAtlas)
+        {
+            cardAtlas = uploadTexture(jobs[1]);
+            if (cardAtlas.id != 0)
+            {
+                GenTextureMipmaps(&cardAtlas);
+                setCardTextureFilter(cardAtlas);
+                return;
+            }
+
+            // Unreadable atlas: fall back to the separate images
+            jobs[1].path = "images/stock.jpg";
+            jobs[1].cardImage = true;
+            decodeImagesParallel(jobs + 1, 1);
+        }
+        stockTexture = uploadTexture(jobs[1]);
+        setCardTextureFilter(stockTexture);
+    }
+
+    // Queues the faces the next frames will draw: the pyramid cards still
+    // in play and the next two stock cards
+    void prefetchCardFaces()
+    {
+        if (headless || cardAtlas.id != 0)
+            return;
+
+        for (int i = 0; i < 28; i++)
+        {
+            Card* card = allPyramidCards[i].card;
+            if (card && card->inPlay)
+                cardFaces.prefetch(card->suit * 13 + card->value - 1);
+        }
+        for (int i = stockTop; i >= 0 && i >= stockTop - 1; i--)
+        {
+            cardFaces.prefetch(stockArray[i]->suit * 13 + stockArray[i]->value - 1);
+        }
+    }
+
+    void initGame()
+    {
+        if (seededDeals)
+            initGame(nextDealSeed++);
+        else
+            initGame((unsigned int)time(nullptr));
+    }
+
+    // Starts a new game from a fixed deal (same seed = same deal everywhere)
+    void initGame(unsigned int seed)
+    {
+        tableDirty = true;
+        animations.clear();
+        undoCount = 0;
+        pyramidBST.clear();
+        stockTop = -1;
+        wasteTop = -1;
+
+        selectedCard1 = nullptr;
+        selectedCard2 = nullptr;
+        selectedPyramid1 = nullptr;
+        selectedPyramid2 = nullptr;
+        currentWasteCard = nullptr;
+        score = 0;
+        moves = 0;
+        gameTimeUs = 0;
+        loseCheckUs = 0;
+        gameWon = false;
+        gameLost = false;
+        cardCount = 0;
+
+        isNewGame = true;
+        currentGameScoreIndex = -1;
+
+        dealSeed = seed;
+        createDeck();
+        shuffleDeck();
+        createPyramid();
+
+        // Add remaining cards to stock
+        for (int i = 28; i < 52; i++)
+        {
+            stockArray[++stockTop] = &allCards[i];
+        }
+
+        deleteSavedGame();
+        currentState = PLAYING;
+        prefetchCardFaces();
+    }
+
+    void createDeck()
+    {
+        cardCount = 0;
+        for (int suit = 0; suit < 4; suit++)
+        {
+            for (int value = 1; value <= 13; value++)
+            {
+                allCards[cardCount] = Card(value, suit, cardCount);
+                cardCount++;
+            }
+        }
+    }
+
+    void shuffleDeck()
+    {
+        // createDeck() already laid out the sorted deck; deal it by seed
+        dealShuffledDeck(allCards, dealSeed);
+    }
+
+    void createPyramid()
+    {
+        int cardIndex = 0;
+
+        for (int row = 0; row < 7; row++)
+        {
+            for (int col = 0; col <= row; col++)
+            {
+                Card* card = &allCards[cardIndex];
+                card->faceUp = true;
+
+                PyramidCard pyramidCard(card, row, col);
+                allPyramidCards[cardIndex] = pyramidCard;
+
+                pyramidBST.insert(pyramidCard);
+
+                cardIndex++;
+            }
+        }
+
+        updateBlockedStatus();
+    }
+
+    void updateBlockedStatus()
+    {
+        // Using BST to efficiently check child blocking status
+        for (int i = 0; i < 28; i++)
+        {
+            PyramidCard& pc = allPyramidCards[i];
+
+            if (!pc.card || !pc.card->inPlay)
+            {
+                pc.blocked = false;
+                continue;
+            }
+
+            if (pc.row == 6)
+            {
+                pc.blocked = false;
+                continue;
+            }
+
+            bool leftBlocking = false;
+            bool rightBlocking = false;
+
+            // Search for left child in BST
+            PyramidCard leftSearch;
+            leftSearch.row = pc.row + 1;
+            leftSearch.col = pc.col;
+            BSTNode<PyramidCard>* leftNode = pyramidBST.search(leftSearch);
+            if (leftNode && leftNode->data.card && leftNode->data.card->inPlay)
+            {
+                leftBlocking = true;
+            }
+
+            // Search for right child in BST
+            PyramidCard rightSearch;
+            rightSearch.row = pc.row + 1;
+            rightSearch.col = pc.col + 1;
+            BSTNode<PyramidCard>* rightNode = pyramidBST.search(rightSearch);
+            if (rightNode && rightNode->data.card && rightNode->data.card->inPlay)
+            {
+                rightBlocking = true;
+            }
+
+            pc.blocked = leftBlocking || rightBlocking;
+        }
+    }
+
+    bool isCardFree(PyramidCard* pc)
+    {
+        if (!pc || !pc->card || !pc->card->inPlay)
+            return false;
+        return !pc->blocked;
+    }
+
+    bool isValidMove(Card* c1, Card* c2)
+    {
+        if (!c1 || !c2)
+            return false;
+        if (!c1->inPlay || !c2->inPlay)
+            return false;
+        return (c1->value + c2->value) == 13;
+    }
+
+    bool isKing(Card* c)
+    {
+        if (!c)
+            return false;
+        return c->value == 13;
+    }
+
+    void drawCardFromStock()
+    {
+        tableDirty = true;
+        playStockDrawSound();
+
+        // If stock is empty, recycle waste pile
+        if (stockTop < 0)
+        {
+            // Move all in-play waste cards back to stock
+            while (wasteTop >= 0)
+            {
+                Card* card = wasteArray[wasteTop--];
+                if (card->inPlay)
+                {
+                    stockArray[++stockTop] = card;
+                }
+            }
+            currentWasteCard = nullptr;
+        }
+
+        // Draw from stock
+        if (stockTop >= 0)
+        {
+            Card* card = stockArray[stockTop--];
+            card->faceUp = true;
+            wasteArray[++wasteTop] = card;
+            currentWasteCard = card;
+            if (!headless)
+                animations.start(ANIM_FLIP, card, getLayout().stock, getLayout().waste, FLIP_SECONDS);
+        }
+
+        prefetchCardFaces();
+    }
+
+    // Sends a matched card from its pyramid slot (or the waste pile when
+    // pc is NULL) to the foundation
+    void launchFlight(Card* card, PyramidCard* pc)
+    {
+        if (headless)
+            return;
+        const TableLayout& table = getLayout();
+        Rectangle from = pc ? table.pyramid[pc - allPyramidCards] : table.waste;
+        animations.start(ANIM_FLIGHT, card, from, table.foundation, FLIGHT_SECONDS);
+    }
+
+    void removeCards()
+    {
+        tableDirty = true;
+        // Handle King removal (single card)
+        if (selectedCard1 && isKing(selectedCard1))
+        {
+            playCardMatchSound();
+            selectedCard1->inPlay = false;
+            launchFlight(selectedCard1, selectedPyramid1);
+
+            // Update current waste card if needed
+            if (currentWasteCard == selectedCard1)
+            {
+                currentWasteCard = nullptr;
+                for (int i = wasteTop - 1; i >= 0; i--)
+                {
+                    if (wasteArray[i]->inPlay)
+                    {
+                        currentWasteCard = wasteArray[i];
+                        break;
+                    }
+                }
+            }
+
+            score += 10;
+            selectedCard1 = nullptr;
+            selectedPyramid1 = nullptr;
+            updateBlockedStatus();
+            checkWinCondition();
+            return;
+        }
+
+        // Handle pair removal
+        if (selectedCard1 && selectedCard2 && isValidMove(selectedCard1, selectedCard2))
+        {
             playCardMatchSound();
             selectedCard1->inPlay = false;
+            selectedCard2->inPlay = false;
+            launchFlight(selectedCard1, selectedPyramid1);
+            launchFlight(selectedCard2, selectedPyramid2);
+
+            // Update current waste card if needed
+            if (currentWasteCard == selectedCard1 || currentWasteCard == selectedCard2)
+            {
+                currentWasteCard = nullptr;
+                for (int i = wasteTop; i >= 0; i--)
+                {
+                    if (wasteArray[i]->inPlay)
+                    {
+                        currentWasteCard = wasteArray[i];
+                        break;
+                    }
+                }
+            }
+
+            score += 20;
+
+            selectedCard1 = nullptr;
+            selectedCard2 = nullptr;
+            selectedPyramid1 = nullptr;
+            selectedPyramid2 = nullptr;
+
+            updateBlockedStatus();
+            checkWinCondition();
+        }
+        else if (selectedCard1 && selectedCard2)
+        {
+            // Invalid pair
+            playCardMismatchSound();
+            selectedCard1 = nullptr;
+            selectedCard2 = nullptr;
+            selectedPyramid1 = nullptr;
+            selectedPyramid2 = nullptr;
+        }
+    }
+
+    void selectCard(Card* card, PyramidCard* pc)
+    {
+        if (!card || !card->inPlay)
+            return;
+        tableDirty = true;
+
+        // Check if pyramid card is blocked
+        if (pc && !isCardFree(pc))
+            return;
+
+        playCardSelectSound();
+
+        // Handle King selection
+        if (isKing(card))
+        {
+            selectedCard1 = card;
+            selectedPyramid1 = pc;
+            selectedCard2 = nullptr;
+            selectedPyramid2 = nullptr;
+            removeCards();
+            return;
+        }
+
+        // Handle regular card selection
+        if (!selectedCard1)
+        {
+            selectedCard1 = card;
+            selectedPyramid1 = pc;
+        }
+        else if (selectedCard1 == card)
+        {
+            // Deselect if clicking same card
+            selectedCard1 = nullptr;
+            selectedPyramid1 = nullptr;
+        }
+        else
+        {
+            selectedCard2 = card;
+            selectedPyramid2 = pc;
+            removeCards();
+        }
+    }
+
+    void checkWinCondition()
+    {
+        bool allRemoved = true;
+
+        for (int i = 0; i < 28; i++)
+        {
+            if (allPyramidCards[i].card && allPyramidCards[i].card->inPlay)
+            {
+                allRemoved = false;
+                break;
+            }
+        }
+
+        if (allRemoved)
+        {
+            gameWon = true;
+            saveCurrentGameScore();
+            deleteSavedGame();
+        }
+    }
+
+    void checkLoseCondition()
+    {
+        if (stockTop >= 0)
+        {
+            return; // Stock has cards = game continues
+        }
+
+        Card* accessibleCards[29];
+        int accessibleCount = 0;
+
+        // Collect ONLY free (unblocked) pyramid cards
+        for (int i = 0; i < 28; i++)
+        {
+            if (isCardFree(&allPyramidCards[i]))
+            {
+                accessibleCards[accessibleCount++] = allPyramidCards[i].card;
+            }
+        }
+
+        // Add ONLY current waste card (top of waste pile)
+        if (currentWasteCard && currentWasteCard->inPlay)
+        {
+            accessibleCards[accessibleCount++] = currentWasteCard;
+        }
+
+        // If no accessible cards at all, game is lost
+        if (accessibleCount == 0)
+        {
+            gameLost = true;
+            saveCurrentGameScore();
+            deleteSavedGame();
+            return;
+        }
+
+        // Check if any King exists in accessible cards
+        for (int i = 0; i < accessibleCount; i++)
+        {
+            if (isKing(accessibleCards[i]))
+            {
+                return; // Valid move exists (can remove King)
+            }
+        }
+
+        // Check if any two accessible cards sum to 13
+        for (int i = 0; i < accessibleCount; i++)
+        {
+            for (int j = i + 1; j < accessibleCount; j++)
+            {
+                if (isValidMove(accessibleCards[i], accessibleCards[j]))
+                {
+                    return; // Valid move exists (can remove pair)
+                }
+            }
+        }
+
+        // Stock empty + no valid moves = GAME LOST
+        gameLost = true;
+        saveCurrentGameScore();
+        deleteSavedGame();
+    }
+
+    // Bytes held by one live game, split by representation
+    void printMemoryFootprint()
+    {
+        long long nodeBytes = sizeof(BSTNode<PyramidCard>);
+        long long bstNodes = pyramidBST.getSize();
+        long long pileBytes = sizeof(stockArray) + sizeof(wasteArray);
+
+        long long saveBytes = SAVE_FILE_BYTES;
+
+        cout << "BST version, bytes per live game:" << endl;
+        cout << "  Card[52]                  " << sizeof(allCards) << endl;
+        cout << "  PyramidCard[28]           " << sizeof(allPyramidCards) << endl;
+        cout << "  BST nodes                 " << bstNodes << " x " << nodeBytes << " = " << bstNodes * nodeBytes
+            << " (" << bstNodes * heapBlockBytes(nodeBytes) << " with malloc overhead)" << endl;
+        cout << "  stock/waste arrays        " << pileBytes << endl;
+        cout << "  PyramidSolitaire object   " << sizeof(PyramidSolitaire)
+            << " (includes everything above except heap nodes)" << endl;
+        cout << "  total                     " << sizeof(PyramidSolitaire) + bstNodes * heapBlockBytes(nodeBytes) << endl;
+        cout << "  save file                 " << saveBytes << endl;
+    }
+
+    // Plays a whole game from a seed without a window: kings first, then the
+    // first valid pair (pyramid or pyramid + waste), otherwise a stock click.
+    // Used by the benchmark harness. Returns the number of actions taken.
+    int simulateGame(unsigned int seed, int maxActions)
+    {
+        initGame(seed);
+
+        int actions = 0;
+        int clicksWithoutRemoval = 0;
+        while (!gameWon && !gameLost && actions < maxActions)
+        {
+            PyramidCard* freeCards[28];
+            int freeCount = 0;
+            for (int i = 0; i < 28; i++)
+            {
+                if (isCardFree(&allPyramidCards[i]))
+                    freeCards[freeCount++] = &allPyramidCards[i];
+            }
+
+            bool removed = false;
+            for (int i = 0; i < freeCount && !removed; i++)
+            {
+                if (isKing(freeCards[i]->card))
+                {
+                    selectCard(freeCards[i]->card, freeCards[i]);
+                    removed = true;
+                }
+            }
+
+            if (!removed && currentWasteCard && currentWasteCard->inPlay)
+            {
+                if (isKing(currentWasteCard))
+                {
+                    selectCard(currentWasteCard, nullptr);
+                    removed = true;
+                }
+                for (int i = 0; i < freeCount && !removed; i++)
+                {
+                    if (isValidMove(freeCards[i]->card, currentWasteCard))
+                    {
+                        selectCard(freeCards[i]->card, freeCards[i]);
+                        selectCard(currentWasteCard, nullptr);
+                        removed = true;
+                    }
+                }
+            }
+
+            for (int i = 0; i < freeCount && !removed; i++)
+            {
+                for (int j = i + 1; j < freeCount && !removed; j++)
+                {
+                    if (isValidMove(freeCards[i]->card, freeCards[j]->card))
+                    {
+                        selectCard(freeCards[i]->card, freeCards[i]);
+                        selectCard(freeCards[j]->card, freeCards[j]);
+                        removed = true;
+                    }
+                }
+            }
+
+            if (removed)
+            {
+                clicksWithoutRemoval = 0;
+            }
+            else
+            {
+                // A full pass through stock and waste with nothing to remove = stuck
+                if (++clicksWithoutRemoval > 52)
+                    break;
+                drawCardFromStock();
+            }
+
+            actions++;
+            checkLoseCondition();
+        }
+
+        return actions;
+    }
+
+    // Slot of the live pyramid card drawn on top at (x, y), or -1. The
+    // point's row band gives the lowest row that can contain it; each
+    // row overlaps only the bottom of the one above, so the rows to test
+    // end as soon as one lies wholly above the point. Within a row the
+    // column is found by division, then checked against the card width
+    // for the gap between cards.
+    int pyramidSlotAt(float x, float y)
+    {
+        const TableLayout& table = getLayout();
+        if (y < table.pyramidTop)
+            return -1;
+
+        int row = (int)((y - table.pyramidTop) / table.rowStep);
+        if (row > 6)
+            row = 6;
+
+        for (int r = row; r >= 0; r--)
+        {
+            int first = r * (r + 1) / 2;
+            const Rectangle& left = table.pyramid[first];
+            if (y >= left.y + left.height)
+                break;
+
+            float dx = x - left.x;
+            if (dx < 0)
+                continue;
+            int col = (int)(dx / table.columnStep);
+            if (col > r || dx - col * table.columnStep >= left.width)
+                continue;
+
+            // A removed card shows the one behind it
+            PyramidCard& pc = allPyramidCards[first + col];
+            if (pc.card && pc.card->inPlay)
+                return first + col;
+        }
+        return -1;
+    }
+
+    void handleMouseClick(int mouseX, int mouseY)
+    {
+        if (gameWon || gameLost)
+            return;
+
+        const TableLayout& table = getLayout();
+
+        // Check pyramid cards
+        int slot = pyramidSlotAt((float)mouseX, (float)mouseY);
+        if (slot >= 0)
+        {
+            selectCard(allPyramidCards[slot].card, &allPyramidCards[slot]);
+            return;
+        }
+
+        // Check waste pile
+        if (currentWasteCard && currentWasteCard->inPlay)
+        {
+            if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, table.waste))
+            {
+                selectCard(currentWasteCard, nullptr);
+                return;
+            }
+        }
+
+        // Check stock pile
+        if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, table.stock))
+        {
+            clickStock();
+            return;
+        }
+    }
+
+    // Drawing from the stock also drops any selection
+    void clickStock()
+    {
+        drawCardFromStock();
+        selectedCard1 = nullptr;
+        selectedCard2 = nullptr;
+        selectedPyramid1 = nullptr;
+        selectedPyramid2 = nullptr;
+    }
+
+    // Layout and drawing use canvas coordinates whatever the window size
+    int screenWidth()
+    {
+        return CANVAS_WIDTH;
+    }
+
+    int screenHeight()
+    {
+        return CANVAS_HEIGHT;
+    }
+
+    // Where the canvas is drawn in the window: as large as fits, keeping
+    // its aspect ratio, centered with black bars on the other axis
+    Rectangle canvasViewport()
+    {
+        if (headless)
+            return { 0, 0, (float)CANVAS_WIDTH, (float)CANVAS_HEIGHT };
+
+        float windowWidth = (float)GetScreenWidth();
+        float windowHeight = (float)GetScreenHeight();
+        float scale = min(windowWidth / CANVAS_WIDTH, windowHeight / CANVAS_HEIGHT);
+        float width = CANVAS_WIDTH * scale;
+        float height = CANVAS_HEIGHT * scale;
+        return { (windowWidth - width) / 2, (windowHeight - height) / 2, width, height };
+    }
+
+    // Window position (e.g. the mouse) to canvas coordinates
+    Vector2 windowToCanvas(Vector2 point)
+    {
+        Rectangle viewport = canvasViewport();
+        float scale = viewport.width / CANVAS_WIDTH;
+        return { (point.x - viewport.x) / scale, (point.y - viewport.y) / scale };
+    }
+
+    // Render textures are filtered so scaling the canvas stays smooth
+    static RenderTexture2D loadCanvasTexture()
+    {
+        RenderTexture2D target = LoadRenderTexture(CANVAS_WIDTH, CANVAS_HEIGHT);
+        SetTextureFilter(target.texture, TEXTURE_FILTER_BILINEAR);
+        return target;
+    }
+
+    const TableLayout& getLayout()
+    {
+        int sw = screenWidth();
+        int sh = screenHeight();
+        if (layout.width == sw && layout.height == sh)
+            return layout;
+
+        layout.width = sw;
+        layout.height = sh;
+
+        int slot = 0;
+        for (int row = 0; row < 7; row++)
+        {
+            int startX = (sw / 2) - (row * (CARD_WIDTH + CARD_SPACING) / 2);
+            int y = 100 + row * (CARD_HEIGHT / 2 + CARD_SPACING);
+            for (int col = 0; col <= row; col++)
+            {
+                int x = startX + col * (CARD_WIDTH + CARD_SPACING);
+                layout.pyramid[slot++] = { (float)x, (float)y, (float)CARD_WIDTH, (float)CARD_HEIGHT };
+            }
+        }
+
+        layout.pyramidTop = 100;
+        layout.rowStep = (float)(CARD_HEIGHT / 2 + CARD_SPACING);
+        layout.columnStep = (float)(CARD_WIDTH + CARD_SPACING);
+
+        layout.pileY = 150 + 7 * (CARD_HEIGHT / 2 + CARD_SPACING);
+        layout.waste = { 50.0f, (float)layout.pileY, (float)CARD_WIDTH, (float)CARD_HEIGHT };
+        layout.stock = { 180.0f, (float)layout.pileY, (float)CARD_WIDTH, (float)CARD_HEIGHT };
+        layout.restartButton = { (float)(sw - 150), (float)(sh - 60), 120, 50 };
+        layout.foundation = { (float)(sw - 150), (float)layout.pileY, (float)CARD_WIDTH * 0.5f, (float)CARD_HEIGHT * 0.5f };
+        return layout;
+    }
+
+    // Records the back of a card (the stock image), marks at layer + 1
+    void drawCardBack(DrawList& list, int layer, Rectangle rect)
+    {
+        if (cardAtlas.id != 0)
+        {
+            list.texture(layer, cardAtlas, cardAtlasRegions[ATLAS_STOCK_CELL], rect, WHITE);
+        }
+        else if (stockTexture.id != 0)
+        {
+            list.texture(layer, stockTexture,
+                { 0, 0, (float)stockTexture.width, (float)stockTexture.height }, rect, WHITE);
+        }
+        else
+        {
+            list.rect(layer, rect, BLUE);
+            list.rectLines(layer + 1, rect, 2, WHITE);
+            if (rect.width > 70)
+                list.text(layer + 1, "STOCK", rect.x + 15, rect.y + 55, 18, WHITE);
+        }
+    }
+
+    // Next in-play card under card on the waste pile, or NULL
+    Card* wasteCardBelow(Card* card)
+    {
+        int i = wasteTop;
+        while (i >= 0 && wasteArray[i] != card)
+            i--;
+        for (i--; i >= 0; i--)
+        {
+            if (wasteArray[i]->inPlay)
+                return wasteArray[i];
+        }
+        return NULL;
+    }
+
+    // Moving cards: flights shrink towards the foundation; flips narrow
+    // to an edge showing the back, then widen showing the face
+    void drawAnimations(DrawList& list)
+    {
+        for (int i = 0; i < animations.capacity(); i++)
+        {
+            const CardAnimationPool::Animation& animation = animations.at(i);
+            if (!animation.active)
+                continue;
+
+            float t = CardAnimationPool::progress(animation, tickFraction() * SIM_TICK_US / 1e6f);
+            Rectangle rect = CardAnimationPool::lerp(animation.from, animation.to, t);
+            if (animation.kind == ANIM_FLIP)
+            {
+                float turn = (t < 0.5f) ? 1.0f - 2.0f * t : 2.0f * t - 1.0f;
+                float width = rect.width * turn;
+                rect.x += (rect.width - width) / 2;
+                rect.width = width;
+                if (t < 0.5f)
+                {
+                    drawCardBack(list, LAYER_ANIMATION, rect);
+                    continue;
+                }
+            }
+            drawCard(list, LAYER_ANIMATION, animation.card, rect, false);
+        }
+    }
+
+    // Records a card: its face at layer, outlines and marks at layer + 1
+    void drawCard(DrawList& list, int layer, Card* card, Rectangle rect, bool selected)
+    {
+        if (!card)
+            return;
+
+        if (!card->faceUp)
+        {
+            list.rect(layer, rect, DARKBLUE);
+            list.rectLines(layer + 1, rect, 2, BLACK);
+            list.text(layer + 1, "?", rect.x + rect.width / 2 - 10, rect.y + rect.height / 2 - 10, 30, WHITE);
+            return;
+        }
+
+        int cell = card->suit * 13 + card->value - 1;
+        Texture2D tex = { 0 };
+        if (cardAtlas.id == 0)
+            tex = cardFaces.get(cell);
+
+        if (cardAtlas.id != 0)
+        {
+            list.texture(layer, cardAtlas, cardAtlasRegions[cell], rect, WHITE);
+        }
+        else if (tex.id != 0)
+        {
+            list.texture(layer, tex, { 0, 0, (float)tex.width, (float)tex.height }, rect, WHITE);
+        }
+        else
+        {
+            Color suitColor = (card->suit == 0 || card->suit == 1) ? RED : BLACK;
+            list.rect(layer, rect, WHITE);
+            list.rectLines(layer + 1, rect, 2, BLACK);
+
+            const char* values[13] = { "A", "2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K" };
+            list.text(layer + 1, values[card->value - 1], rect.x + 10, rect.y + 10, 20, suitColor);
+
+            const char* suitSymbols[4] = { "♥️", "♦️", "♣️", "♠️" };
+            list.text(layer + 1, suitSymbols[card->suit], rect.x + 10, rect.y + 35, 25, suitColor);
+        }
+
+        if (selected)
+        {
+            list.rectLines(layer + 1, rect, 3, YELLOW);
+        }
+    }
+
+    void drawBackground()
+    {
+        if (background.id != 0)
+        {
+            DrawTexturePro(background,
+                { 0, 0, (float)background.width, (float)background.height },
+                { 0, 0, (float)screenWidth(), (float)screenHeight() },
+                { 0, 0 }, 0, WHITE);
+        }
+        else
+        {
+            ClearBackground(DARKGREEN);
+        }
+    }
+
+    void drawHighScores()
+    {
+        drawBackground();
+
+        int sw = screenWidth();
+        int sh = screenHeight();
+
+        DrawRectangle(0, 0, sw, sh, { 0, 0, 0, 150 });
+        DrawText("TOP 5 HIGH SCORES", sw / 2 - 180, 100, 40, GOLD);
+
+        for (int i = 0; i < highScoreCount; i++)
+        {
+            DrawText(TextFormat("%d. %d", i + 1, highScores[i]), sw / 2 - 50, 200 + i * 60, 35, WHITE);
+        }
+
+        if (highScoreCount == 0)
+        {
+            DrawText("No scores yet!", sw / 2 - 80, 200, 30, WHITE);
+        }
+
+        Rectangle backBtn = { (float)(sw / 2 - 100), sh - 120.0f, 200, 50 };
+        DrawRectangleRec(backBtn, DARKGRAY);
+        DrawRectangleLinesEx(backBtn, 2, WHITE);
+        DrawText("BACK TO MENU", sw / 2 - 85, sh - 105, 20, WHITE);
+
+    }
+
+    void handleHighScoresClick(int mouseX, int mouseY)
+    {
+        int sw = screenWidth();
+        int sh = screenHeight();
+
+        Rectangle backBtn = { (float)(sw / 2 - 100), sh - 120.0f, 200, 50 };
+        if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, backBtn))
+        {
+            currentState = MAIN_MENU;
+        }
+    }
+
+    void drawMainMenu()
+    {
+        drawBackground();
+
+        int sw = screenWidth();
+        int sh = screenHeight();
+
+        DrawText("PYRAMID SOLITAIRE", sw / 2 - 250, sh / 2 - 300, 50, GOLD);
+
+        Rectangle playBtn = { (float)(sw / 2 - 150), (float)(sh / 2 - 180), 300, 60 };
+        Rectangle loadBtn = { (float)(sw / 2 - 150), (float)(sh / 2 - 90), 300, 60 };
+        Rectangle instructBtn = { (float)(sw / 2 - 150), (float)(sh / 2), 300, 60 };
+        Rectangle highScoreBtn = { (float)(sw / 2 - 150), (float)(sh / 2 + 90), 300, 60 };
+        Rectangle exitBtn = { (float)(sw / 2 - 150), (float)(sh / 2 + 180), 300, 60 };
+
+        DrawRectangleRec(playBtn, DARKGREEN);
+        DrawRectangleLinesEx(playBtn, 3, GREEN);
+        DrawText("NEW GAME", sw / 2 - 110, sh / 2 - 160, 25, WHITE);
+
+        if (savedGameExists)
+        {
+            DrawRectangleRec(loadBtn, PURPLE);
+            DrawRectangleLinesEx(loadBtn, 3, VIOLET);
+            DrawText("LOAD GAME", sw / 2 - 110, sh / 2 - 70, 25, WHITE);
+        }
+        else
+        {
+            DrawRectangleRec(loadBtn, DARKGRAY);
+            DrawRectangleLinesEx(loadBtn, 3, GRAY);
+            DrawText("LOAD GAME", sw / 2 - 110, sh / 2 - 70, 25, GRAY);
+        }
+
+        DrawRectangleRec(instructBtn, DARKBLUE);
+        DrawRectangleLinesEx(instructBtn, 3, BLUE);
+        DrawText("INSTRUCTIONS", sw / 2 - 110, sh / 2 + 20, 25, WHITE);
+
+        DrawRectangleRec(highScoreBtn, ORANGE);
+        DrawRectangleLinesEx(highScoreBtn, 3, RED);
+        DrawText("HIGH SCORES", sw / 2 - 100, sh / 2 + 110, 25, WHITE);
+
+        DrawRectangleRec(exitBtn, DARKGRAY);
+        DrawRectangleLinesEx(exitBtn, 3, BLACK);
+        DrawText("EXIT GAME", sw / 2 - 80, sh / 2 + 200, 25, WHITE);
+
+    }
+
+    void drawInstructions()
+    {
+        drawBackground();
+
+        int sw = screenWidth();
+        int sh = screenHeight();
+
+        DrawRectangle(sw / 2 - 400, 100, 800, 700, { 0, 0, 0, 200 });
+        DrawRectangleLinesEx({ (float)(sw / 2 - 400), 100, 800, 700 }, 3, GOLD);
+
+        DrawText("HOW TO PLAY PYRAMID SOLITAIRE", sw / 2 - 280, 130, 30, GOLD);
+
+        int y = 190;
+        int spacing = 35;
+
+        DrawText("OBJECTIVE:", sw / 2 - 350, y, 25, YELLOW);
+        y += spacing;
+        DrawText("Remove all cards from the pyramid by pairing cards", sw / 2 - 350, y, 20, WHITE);
+        y += spacing - 5;
+        DrawText("that add up to 13.", sw / 2 - 350, y, 20, WHITE);
+        y += spacing + 10;
+
+        DrawText("RULES:", sw / 2 - 350, y, 25, YELLOW);
+        y += spacing;
+        DrawText("1. Only uncovered cards can be selected.", sw / 2 - 350, y, 20, WHITE);
+        y += spacing + 5;
+        DrawText("2. Pair two cards that sum to 13:", sw / 2 - 350, y, 20, WHITE);
+        y += spacing - 5;
+        DrawText("   Ace(1) + Queen(12), 2 + Jack(11), 3 + 10,", sw / 2 - 350, y, 20, WHITE);
+        y += spacing - 5;
+        DrawText("   4 + 9, 5 + 8, 6 + 7", sw / 2 - 350, y, 20, WHITE);
+        y += spacing + 5;
+        DrawText("3. Kings (13) can be removed individually.", sw / 2 - 350, y, 20, WHITE);
+        y += spacing + 5;
+        DrawText("4. Click STOCK to draw (unlimited draws).", sw / 2 - 350, y, 20, WHITE);
+        y += spacing + 5;
+        DrawText("5. Stock recycles automatically when empty.", sw / 2 - 350, y, 20, WHITE);
+        y += spacing + 10;
+
+        DrawText("CONTROLS:", sw / 2 - 350, y, 25, YELLOW);
+        y += spacing;
+        DrawText("P - Pause/Resume game", sw / 2 - 350, y, 20, WHITE);
+        y += spacing;
+        DrawText("S - Save current game", sw / 2 - 350, y, 20, WHITE);
+        y += spacing;
+        DrawText("BACKSPACE - Return to main menu (auto-saves)", sw / 2 - 350, y, 20, WHITE);
+        y += spacing + 10;
+
+        DrawText("SCORING:", sw / 2 - 350, y, 25, YELLOW);
+        y += spacing;
+        DrawText("King removed: +10 points", sw / 2 - 350, y, 20, WHITE);
+        y += spacing - 5;
+        DrawText("Pair removed: +20 points", sw / 2 - 350, y, 20, WHITE);
+
+        Rectangle backBtn = { (float)(sw / 2 - 100), (float)(sh - 120), 200, 50 };
+        DrawRectangleRec(backBtn, DARKGRAY);
+        DrawRectangleLinesEx(backBtn, 2, WHITE);
+        DrawText("BACK TO MENU", sw / 2 - 85, sh - 105, 20, WHITE);
+
+    }
+
+    void handleMainMenuClick(int mouseX, int mouseY)
+    {
+        int sw = screenWidth();
+        int sh = screenHeight();
+
+        Rectangle playBtn = { (float)(sw / 2 - 150), (float)(sh / 2 - 180), 300, 60 };
+        Rectangle loadBtn = { (float)(sw / 2 - 150), (float)(sh / 2 - 90), 300, 60 };
+        Rectangle instructBtn = { (float)(sw / 2 - 150), (float)(sh / 2), 300, 60 };
+        Rectangle highScoreBtn = { (float)(sw / 2 - 150), (float)(sh / 2 + 90), 300, 60 };
+        Rectangle exitBtn = { (float)(sw / 2 - 150), (float)(sh / 2 + 180), 300, 60 };
+
+        if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, playBtn))
+        {
+            initGame();
+        }
+        else if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, loadBtn) && savedGameExists)
+        {
+            loadGame();
+        }
+        else if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, instructBtn))
+        {
+            currentState = INSTRUCTIONS;
+        }
+        else if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, highScoreBtn))
+        {
+            currentState = HIGH_SCORES;
+        }
+        else if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, exitBtn))
+        {
+            quitRequested = true;
+        }
+    }
+
+    void handleInstructionsClick(int mouseX, int mouseY)
+    {
+        int sw = screenWidth();
+        int sh = screenHeight();
+
+        Rectangle backBtn = { (float)(sw / 2 - 100), (float)(sh - 120), 200, 50 };
+        if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, backBtn))
+        {
+            currentState = MAIN_MENU;
+        }
+    }
+
+    // Draws the current menu screen into menuLayer if it is not already
+    // there, then blits it
+    void renderMenu()
+    {
+        int sw = screenWidth();
+        int sh = screenHeight();
+
+        if (menuLayer.id == 0)
+        {
+            menuLayer = loadCanvasTexture();
+            menuLayerState = -1;
+        }
+
+        if (menuLayerState != currentState)
+        {
+            BeginTextureMode(menuLayer);
+            if (currentState == HIGH_SCORES)
+                drawHighScores();
+            else if (currentState == MAIN_MENU)
+                drawMainMenu();
+            else
+                drawInstructions();
+            EndTextureMode();
+            menuLayerState = currentState;
+        }
+
+        BeginDrawing();
+        ClearBackground(BLACK);
+        DrawTexturePro(menuLayer.texture, { 0, 0, (float)sw, (float)-sh }, canvasViewport(), { 0, 0 }, 0, WHITE);
+        EndDrawing();
+    }
 
-            // Update current waste card if needed
-            if (currentWasteCard == selectedCard1)
+    // Everything on the table that only changes on a move (see tableLayer)
+    void drawTable()
+    {
+        const TableLayout& table = getLayout();
+        DrawList& list = tableDraws;
+        int sw = table.width;
+        int sh = table.height;
+
+        if (background.id != 0)
+        {
+            list.texture(LAYER_BACKGROUND, background,
+                { 0, 0, (float)background.width, (float)background.height },
+                { 0, 0, (float)sw, (float)sh }, WHITE);
+        }
+        else
+        {
+            list.rect(LAYER_BACKGROUND, { 0, 0, (float)sw, (float)sh }, DARKGREEN);
+        }
+
+        list.text(LAYER_HUD, TextFormat("Score: %d", score), 20, 20, 25, GOLD);
+        list.text(LAYER_HUD, TextFormat("Moves: %d", moves), sw - 150, 20, 25, YELLOW);
+
+        // Draw pyramid cards (managed by BST)
+        for (int i = 0; i < 28; i++)
+        {
+            PyramidCard& pc = allPyramidCards[i];
+            if (pc.card && pc.card->inPlay)
             {
-                currentWasteCard = nullptr;
-                for (int i = wasteTop - 1; i >= 0; i--)
+                Rectangle rect = table.pyramid[i];
+                int layer = LAYER_PYRAMID + 2 * pc.row;
+                bool selected = (&pc == selectedPyramid1 || &pc == selectedPyramid2);
+                drawCard(list, layer, pc.card, rect, selected);
+
+                // Draw red line on blocked cards
+                if (pc.blocked)
                 {
-                    if (wasteArray[i]->inPlay)
-                    {
-                        currentWasteCard = wasteArray[i];
-                        break;
-                    }
+                    list.rect(layer + 1, { rect.x, rect.y, rect.width, 5 }, RED);
                 }
             }
+        }
+
+        int uiStartY = table.pileY;
+
+        // Draw waste pile
+        list.text(LAYER_HUD, "WASTE", 50, uiStartY - 30, 20, WHITE);
+        // A card still flipping over is drawn in flight; show the one below
+        Card* wasteCard = currentWasteCard;
+        if (wasteCard && animations.hides(wasteCard))
+            wasteCard = wasteCardBelow(wasteCard);
+
+        if (wasteCard && wasteCard->inPlay)
+        {
+            bool selected = (wasteCard == selectedCard1 || wasteCard == selectedCard2);
+            drawCard(list, LAYER_PILES, wasteCard, table.waste, selected);
+        }
+        else
+        {
+            list.rectLines(LAYER_PILE_MARKS, table.waste, 2, GRAY);
+        }
+
+        // Draw stock pile
+        Rectangle stockRect = table.stock;
+        list.text(LAYER_HUD, "STOCK", 180, uiStartY - 30, 20, WHITE);
+        list.text(LAYER_HUD, TextFormat("(%d)", stockTop + 1), 190, uiStartY + CARD_HEIGHT + 5, 18, LIGHTGRAY);
+
+        if (stockTop >= 0)
+        {
+            drawCardBack(list, LAYER_PILES, stockRect);
+        }
+        else
+        {
+            list.rectLines(LAYER_PILE_MARKS, stockRect, 2, GRAY);
+            list.text(LAYER_HUD, "RECYCLE", stockRect.x + 8, stockRect.y + 55, 16, GRAY);
+        }
+
+        // Draw restart button
+        Rectangle restartBtn = table.restartButton;
+        list.rect(LAYER_PILES, restartBtn, MAROON);
+        list.rectLines(LAYER_PILE_MARKS, restartBtn, 2, WHITE);
+        list.text(LAYER_HUD, "RESTART", sw - 140, sh - 45, 20, WHITE);
+
+        list.text(LAYER_HUD, "Press S to Save", 20, sh - 30, 20, LIGHTGRAY);
+
+        list.submit();
+    }
+
+    void render()
+    {
+        redrawNeeded = false;
+
+        if (currentState != PLAYING)
+        {
+            renderMenu();
+            return;
+        }
+        menuLayerState = -1;
+
+        int sw = screenWidth();
+        int sh = screenHeight();
+
+        if (tableLayer.id == 0)
+        {
+            tableLayer = loadCanvasTexture();
+            tableDirty = true;
+        }
+
+        if (tableDirty)
+        {
+            cardFaces.beginLayer();
+            BeginTextureMode(tableLayer);
+            drawTable();
+            EndTextureMode();
+            tableDirty = false;
+        }
+
+        DrawList& list = frameDraws;
+        Rectangle screen = { 0, 0, (float)sw, (float)sh };
+
+        // Render textures are stored bottom-up, hence the negative height
+        list.texture(LAYER_BACKGROUND, tableLayer.texture, { 0, 0, (float)sw, (float)-sh }, screen, WHITE);
+
+        // Draw time
+        int totalSeconds = (int)(gameTimeUs / 1000000);
+        int hours = totalSeconds / 3600;
+        int minutes = (totalSeconds % 3600) / 60;
+        int seconds = totalSeconds % 60;
+        clockText.set(TextFormat("Time: %02d:%02d:%02d", hours, minutes, seconds), 25, WHITE);
+        clockText.draw(list, LAYER_HUD, sw / 2 - 80, sh - 30);
+
+        // Show save message
+        if (showSaveMessage && saveMessageUs > 0)
+        {
+            saveText.set("GAME SAVED!", 30, GREEN);
+            saveText.draw(list, LAYER_HUD, sw / 2 - 80, 60);
+        }
+
+        drawAnimations(list);
+
+        // Draw game over messages
+        if (gameWon || gameLost)
+        {
+            list.rect(LAYER_OVERLAY, screen, { 0, 0, 0, 150 });
+            if (gameWon)
+            {
+                overlayTitle.set("YOU WIN!", 40, GOLD);
+                overlayTitle.draw(list, LAYER_OVERLAY_TEXT, sw / 2 - 100, sh / 2 - 50);
+            }
+            else
+            {
+                overlayTitle.set("NO MOVES LEFT!", 40, RED);
+                overlayTitle.draw(list, LAYER_OVERLAY_TEXT, sw / 2 - 150, sh / 2 - 50);
+            }
+            overlayScore.set(TextFormat("Final Score: %d", score), 30, WHITE);
+            overlayScore.draw(list, LAYER_OVERLAY_TEXT, sw / 2 - 100, sh / 2 + 10);
+            overlayHint.set("Press BACKSPACE for menu", 20, LIGHTGRAY);
+            overlayHint.draw(list, LAYER_OVERLAY_TEXT, sw / 2 - 150, sh / 2 + 60);
+        }
+
+        if (isPaused)
+        {
+            list.rect(LAYER_OVERLAY, screen, { 0, 0, 0, 150 });
+            overlayTitle.set("PAUSED", 40, YELLOW);
+            overlayTitle.draw(list, LAYER_OVERLAY_TEXT, sw / 2 - 80, sh / 2);
+            overlayHint.set("Press P to Resume", 25, WHITE);
+            overlayHint.draw(list, LAYER_OVERLAY_TEXT, sw / 2 - 120, sh / 2 + 50);
+        }
+
+        // The frame is recorded in canvas coordinates; the camera scales
+        // it into the viewport
+        Rectangle viewport = canvasViewport();
+        Camera2D camera = { { viewport.x, viewport.y }, { 0, 0 }, 0, viewport.width / CANVAS_WIDTH };
+
+        BeginDrawing();
+        ClearBackground(BLACK);
+        BeginMode2D(camera);
+        list.submit();
+        EndMode2D();
+        EndDrawing();
+        cardFaces.endFrame();
+    }
+
+    // Queues presses from the window as GLFW delivers them, during
+    // raylib's PollInputEvents(). raylib's own handlers run first, so its
+    // input state (and GetMousePosition()) stays current.
+    static void onMouseButton(GLFWwindow* window, int button, int action, int mods)
+    {
+        if (raylibMouseButtonCallback)
+            raylibMouseButtonCallback(window, button, action, mods);
+        if (!windowInput || button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS)
+            return;
+
+        Vector2 mousePos = windowInput->windowToCanvas(GetMousePosition());
+        InputEvent event;
+        event.type = INPUT_CLICK;
+        event.key = 0;
+        event.x = mousePos.x;
+        event.y = mousePos.y;
+        event.time = GetTime();
+        windowInput->inputQueue.push(event);
+    }
+
+    static void onKey(GLFWwindow* window, int key, int scancode, int action, int mods)
+    {
+        if (raylibKeyCallback)
+            raylibKeyCallback(window, key, scancode, action, mods);
+        // GLFW and raylib share key codes
+        if (!windowInput || action != GLFW_PRESS || (key != KEY_BACKSPACE && key != KEY_S && key != KEY_P))
+            return;
+
+        InputEvent event;
+        event.type = INPUT_KEY;
+        event.key = key;
+        event.x = 0;
+        event.y = 0;
+        event.time = GetTime();
+        windowInput->inputQueue.push(event);
+    }
+
+    void installInputCallbacks()
+    {
+        GLFWwindow* window = glfwGetCurrentContext();
+        if (!window)
+            return;
+        windowInput = this;
+        raylibMouseButtonCallback = glfwSetMouseButtonCallback(window, onMouseButton);
+        raylibKeyCallback = glfwSetKeyCallback(window, onKey);
+    }
+
+    void processInputEvent(const InputEvent& event)
+    {
+        bool click = (event.type == INPUT_CLICK);
+        Vector2 mousePos = { event.x, event.y };
+
+        // Handle backspace key
+        if (event.type == INPUT_KEY && event.key == KEY_BACKSPACE)
+        {
+            if (currentState == PLAYING && !gameWon && !gameLost)
+            {
+                saveGame();
+            }
+            currentState = MAIN_MENU;
+            isPaused = false;
+            checkSavedGame();
+            return;
+        }
+
+        // Handle high scores screen
+        if (currentState == HIGH_SCORES)
+        {
+            if (click)
+                handleHighScoresClick((int)mousePos.x, (int)mousePos.y);
+            return;
+        }
+
+        // Handle main menu
+        if (currentState == MAIN_MENU)
+        {
+            if (click)
+                handleMainMenuClick((int)mousePos.x, (int)mousePos.y);
+            return;
+        }
+
+        // Handle instructions screen
+        if (currentState == INSTRUCTIONS)
+        {
+            if (click)
+                handleInstructionsClick((int)mousePos.x, (int)mousePos.y);
+            return;
+        }
+
+        // Handle save key
+        if (event.type == INPUT_KEY && event.key == KEY_S && !gameWon && !gameLost && !isPaused)
+        {
+            saveGame();
+        }
+
+        // Handle pause key
+        if (event.type == INPUT_KEY && event.key == KEY_P && !gameWon && !gameLost)
+        {
+            isPaused = !isPaused;
+        }
+
+        if (!click)
+            return;
+
+        Rectangle restartBtn = getLayout().restartButton;
+
+        // Handle paused state: only the restart button works
+        if (isPaused)
+        {
+            if (CheckCollisionPointRec(mousePos, restartBtn))
+            {
+                initGame();
+            }
+            return;
+        }
+
+        // Handle mouse clicks
+        if (CheckCollisionPointRec(mousePos, restartBtn))
+        {
+            initGame();
+            return;
+        }
+
+        handleMouseClick((int)mousePos.x, (int)mousePos.y);
+    }
+
+    // One simulation tick: the save message, game time, periodic lose
+    // check and moving cards
+    void simulateTick()
+    {
+        // Update save message timer
+        if (showSaveMessage)
+        {
+            saveMessageUs -= SIM_TICK_US;
+            if (saveMessageUs <= 0)
+            {
+                showSaveMessage = false;
+                redrawNeeded = true;
+            }
+        }
+
+        // Moving cards need every frame until they land
+        if (animations.isActive())
+        {
+            if (animations.update(SIM_TICK_US / 1e6f))
+                tableDirty = true;
+            redrawNeeded = true;
+        }
+
+        if (currentState != PLAYING || isPaused)
+            return;
+
+        // Update game time and check lose condition
+        if (!gameWon && !gameLost)
+        {
+            long long shownSecond = gameTimeUs / 1000000;
+            gameTimeUs += SIM_TICK_US;
+            if (gameTimeUs / 1000000 != shownSecond)
+                redrawNeeded = true;
+
+            loseCheckUs += SIM_TICK_US;
+            if (loseCheckUs >= 500000)
+            {
+                checkLoseCondition();
+                loseCheckUs = 0;
+                if (gameLost)
+                    redrawNeeded = true;
+            }
+        }
+    }
+
+    // Runs as many whole ticks as fit in the time passed plus what was
+    // left over last time
+    void advanceClock(float seconds)
+    {
+        long long elapsedUs = (long long)(seconds * 1e6f + 0.5f);
+        if (elapsedUs > SIM_MAX_FRAME_US)
+            elapsedUs = SIM_MAX_FRAME_US;
+        simAccumulatorUs += elapsedUs;
+
+        while (simAccumulatorUs >= SIM_TICK_US)
+        {
+            simulateTick();
+            simAccumulatorUs -= SIM_TICK_US;
+        }
+    }
+
+    // How long --idle may sleep before the simulation has something new to
+    // show: the clock's next second or the save message expiring. While
+    // either is pending the sleep stays within SIM_MAX_FRAME_US, so
+    // advanceClock() drops no game time.
+    double idleWaitSeconds() const
+    {
+        bool clockRunning = currentState == PLAYING && !isPaused && !gameWon && !gameLost;
+        long long waitUs = 1000000;
+        if (clockRunning)
+            waitUs = 1000000 - gameTimeUs % 1000000;
+        if (showSaveMessage && saveMessageUs < waitUs)
+            waitUs = saveMessageUs;
+        if ((clockRunning || showSaveMessage) && waitUs > SIM_MAX_FRAME_US)
+            waitUs = SIM_MAX_FRAME_US;
+
+        waitUs -= simAccumulatorUs;
+        return (waitUs > 0) ? waitUs / 1e6 : 0.0;
+    }
+
+    // How far the next tick is along, in [0, 1)
+    float tickFraction() const
+    {
+        return (float)simAccumulatorUs / SIM_TICK_US;
+    }
+
+    void update(float deltaTime)
+    {
+        if (!headless)
+            pollSaveResults();
+
+        InputEvent event;
+        while (inputQueue.pop(event))
+        {
+            redrawNeeded = true;
+            recordInputEvent(event);
+            processInputEvent(event);
+
+            // BACKSPACE ends the frame, as it always has; anything after
+            // it stays queued for the next one
+            if (event.type == INPUT_KEY && event.key == KEY_BACKSPACE)
+                return;
+        }
+
+        advanceClock(deltaTime);
+    }
+
+    // Print draw list averages at exit (--draw-stats)
+    void enableDrawStats()
+    {
+        drawStatsEnabled = true;
+    }
+
+    bool needsRedraw() const
+    {
+        return redrawNeeded;
+    }
+
+    void requestRedraw()
+    {
+        redrawNeeded = true;
+    }
+
+    bool shouldQuit() const
+    {
+        return quitRequested;
+    }
+
+    // Texture memory for card faces; least recently drawn faces are
+    // unloaded above it (0 = keep every face once loaded)
+    void setTextureBudget(long long bytes)
+    {
+        cardFaces.setBudget(bytes);
+    }
+
+    /* ---------- Pipe automation protocol (see runPipeSession) ---------- */
+
+    void pushUndo()
+    {
+        if (!undoRing)
+            undoRing = new GameSnapshot[UNDO_DEPTH];
+
+        GameSnapshot& snapshot = undoRing[undoNext];
+        undoNext = (undoNext + 1) % UNDO_DEPTH;
+        if (undoCount < UNDO_DEPTH)
+            undoCount++;
+
+        for (int i = 0; i < 52; i++)
+        {
+            snapshot.cardFlags[i] = (unsigned char)(allCards[i].faceUp | (allCards[i].inPlay << 1));
+        }
+        for (int i = 0; i <= stockTop; i++)
+        {
+            snapshot.stock[i] = (signed char)(stockArray[i] - allCards);
+        }
+        for (int i = 0; i <= wasteTop; i++)
+        {
+            snapshot.waste[i] = (signed char)(wasteArray[i] - allCards);
+        }
+        snapshot.stockTop = (signed char)stockTop;
+        snapshot.wasteTop = (signed char)wasteTop;
+        snapshot.wasteCard = currentWasteCard ? (signed char)(currentWasteCard - allCards) : -1;
+        snapshot.selected1 = selectedCard1 ? (signed char)(selectedCard1 - allCards) : -1;
+        snapshot.selected2 = selectedCard2 ? (signed char)(selectedCard2 - allCards) : -1;
+        snapshot.selectedSlot1 = selectedPyramid1 ? (signed char)(selectedPyramid1 - allPyramidCards) : -1;
+        snapshot.selectedSlot2 = selectedPyramid2 ? (signed char)(selectedPyramid2 - allPyramidCards) : -1;
+        snapshot.score = score;
+        snapshot.moves = moves;
+        snapshot.gameWon = gameWon;
+        snapshot.gameLost = gameLost;
+    }
 
-            score += 10;
-            selectedCard1 = nullptr;
-            selectedPyramid1 = nullptr;
-            updateBlockedStatus();
-            checkWinCondition();
+    bool popUndo()
+    {
+        if (undoCount == 0)
+            return false;
+        undoNext = (undoNext + UNDO_DEPTH - 1) % UNDO_DEPTH;
+        undoCount--;
+        const GameSnapshot& snapshot = undoRing[undoNext];
+
+        for (int i = 0; i < 52; i++)
+        {
+            allCards[i].faceUp = (snapshot.cardFlags[i] & 1) != 0;
+            allCards[i].inPlay = (snapshot.cardFlags[i] & 2) != 0;
+        }
+        stockTop = snapshot.stockTop;
+        wasteTop = snapshot.wasteTop;
+        for (int i = 0; i <= stockTop; i++)
+        {
+            stockArray[i] = &allCards[snapshot.stock[i]];
+        }
+        for (int i = 0; i <= wasteTop; i++)
+        {
+            wasteArray[i] = &allCards[snapshot.waste[i]];
+        }
+        currentWasteCard = (snapshot.wasteCard >= 0) ? &allCards[snapshot.wasteCard] : nullptr;
+        selectedCard1 = (snapshot.selected1 >= 0) ? &allCards[snapshot.selected1] : nullptr;
+        selectedCard2 = (snapshot.selected2 >= 0) ? &allCards[snapshot.selected2] : nullptr;
+        selectedPyramid1 = (snapshot.selectedSlot1 >= 0) ? &allPyramidCards[snapshot.selectedSlot1] : nullptr;
+        selectedPyramid2 = (snapshot.selectedSlot2 >= 0) ? &allPyramidCards[snapshot.selectedSlot2] : nullptr;
+        score = snapshot.score;
+        moves = snapshot.moves;
+        gameWon = snapshot.gameWon;
+        gameLost = snapshot.gameLost;
+
+        animations.clear();
+        updateBlockedStatus();
+        tableDirty = true;
+        return true;
+    }
+
+    static void appendCardName(string& out, const Card* card)
+    {
+        if (!card)
+        {
+            out += "--";
             return;
         }
+        out += cardValueCodes[card->value - 1];
+        out += cardSuitCodes[card->suit];
+    }
 
-        // Handle pair removal
-        if (selectedCard1 && selectedCard2 && isValidMove(selectedCard1, selectedCard2))
+    // One line: key=value fields, then the 28 pyramid slots in row order
+    // ("--" = removed)
+    void describeState(string& out)
+    {
+        const char* stateNames[4] = { "menu", "playing", "instructions", "high-scores" };
+        out += TextFormat("state=%s seed=%u score=%d moves=%d ",
+            stateNames[currentState], dealSeed, score, moves);
+        // The game clock only runs with a window open
+        if (!headless)
+            out += TextFormat("time=%lld ", gameTimeUs / 1000000);
+        out += TextFormat("stock=%d waste=", stockTop + 1);
+        appendCardName(out, (currentWasteCard && currentWasteCard->inPlay) ? currentWasteCard : NULL);
+        out += " selected=";
+        appendCardName(out, selectedCard1);
+        out += TextFormat(" won=%d lost=%d pyramid=", gameWon ? 1 : 0, gameLost ? 1 : 0);
+        for (int i = 0; i < 28; i++)
         {
-            playCardMatchSound();
-            selectedCard1->inPlay = false;
-            selectedCard2->inPlay = false;
+            Card* card = allPyramidCards[i].card;
+            if (i > 0)
+                out += ',';
+            appendCardName(out, (card && card->inPlay) ? card : NULL);
+        }
+    }
 
-            // Update current waste card if needed
-            if (currentWasteCard == selectedCard1 || currentWasteCard == selectedCard2)
+    // Runs one protocol command and sets response to "ok <state>" or
+    // "error <reason>". Returns false for quit.
+    bool runPipeCommand(const char* line, string& response)
+    {
+        char command[16] = { 0 };
+        int row = -1;
+        int col = -1;
+        unsigned int seed = 0;
+        const char* error = NULL;
+        redrawNeeded = true;
+
+        if (strlen(line) > PIPE_LINE_MAX)
+        {
+            error = "line too long";
+        }
+        else if (sscanf(line, "%15s", command) != 1)
+        {
+            error = "empty command";
+        }
+        else if (strcmp(command, "quit") == 0)
+        {
+            response = "ok bye";
+            return false;
+        }
+        else if (strcmp(command, "query") == 0)
+        {
+        }
+        else if (strcmp(command, "new") == 0)
+        {
+            if (sscanf(line, "new %u", &seed) == 1)
+                initGame(seed);
+            else
+                initGame();
+        }
+        else if (strcmp(command, "undo") == 0)
+        {
+            // The score is already recorded and the save deleted once a game ends
+            if (currentState == PLAYING && (gameWon || gameLost))
+                error = "game over";
+            else if (!popUndo())
+                error = "nothing to undo";
+        }
+        else if (currentState != PLAYING)
+        {
+            error = "no game in progress";
+        }
+        else if (strcmp(command, "save") == 0)
+        {
+            if (!writeSaveFile())
+                error = "could not save";
+        }
+        else if (gameWon || gameLost)
+        {
+            error = "game over";
+        }
+        else if (isPaused)
+        {
+            error = "paused";
+        }
+        else if (strcmp(command, "select") == 0)
+        {
+            if (sscanf(line, "select %d %d", &row, &col) != 2 || row < 0 || row > 6 || col < 0 || col > row)
             {
-                currentWasteCard = nullptr;
-                for (int i = wasteTop; i >= 0; i--)
+                error = "usage: select <row 0-6> <col 0-row>";
+            }
+            else
+            {
+                PyramidCard* pc = &allPyramidCards[row * (row + 1) / 2 + col];
+                if (!pc->card || !pc->card->inPlay)
+                    error = "card removed";
+                else if (!isCardFree(pc))
+                    error = "card blocked";
+                else
                 {
-                    if (wasteArray[i]->inPlay)
-                    {
-                        currentWasteCard = wasteArray[i];
-                        break;
-                    }
+                    pushUndo();
+                    selectCard(pc->card, pc);
                 }
             }
+        }
+        else if (strcmp(command, "waste") == 0)
+        {
+            if (!currentWasteCard || !currentWasteCard->inPlay)
+                error = "waste empty";
+            else
+            {
+                pushUndo();
+                selectCard(currentWasteCard, nullptr);
+            }
+        }
+        else if (strcmp(command, "draw") == 0)
+        {
+            pushUndo();
+            clickStock();
+        }
+        else
+        {
+            error = "unknown command";
+        }
 
-            score += 20;
-
-            selectedCard1 = nullptr;
-            selectedCard2 = nullptr;
-            selectedPyramid1 = nullptr;
-            selectedPyramid2 = nullptr;
+        // Headless games never run the clock, so the lose check follows each move
+        if (!error && currentState == PLAYING && !gameWon && !gameLost)
+            checkLoseCondition();
 
-            updateBlockedStatus();
-            checkWinCondition();
+        if (error)
+        {
+            response = "error ";
+            response += error;
         }
-        else if (selectedCard1 && selectedCard2)
+        else
         {
-            // Invalid pair
-            playCardMismatchSound();
-            selectedCard1 = nullptr;
-            selectedCard2 = nullptr;
-            selectedPyramid1 = nullptr;
-            selectedPyramid2 = nullptr;
+            response = "ok ";
+            describeState(response);
         }
+        return true;
     }
 
-    void selectCard(Card* card, PyramidCard* pc)
+    /* ---------- Input recording / replay support ---------- */
+
+    // Every game started from now on is dealt from seed, seed + 1, ...
+    // so a recorded session replays with the same deals.
+    void useSeedSequence(unsigned int seed)
     {
-        if (!card || !card->inPlay)
-            return;
+        seededDeals = true;
+        nextDealSeed = seed;
+    }
 
-        // Check if pyramid card is blocked
-        if (pc && !isCardFree(pc))
+    bool startRecording(const char* path)
+    {
+        recordFile.open(path, ios::trunc);
+        if (!recordFile.is_open())
+        {
+            cout << "Error: Could not record input to " << path << endl;
+            return false;
+        }
+
+        // Same sequence as --pipe, so recorded deals are reproducible
+        unsigned int seed = 1;
+        useSeedSequence(seed);
+        recordFile << "# Pyramid Solitaire input recording" << endl;
+        recordFile << "seed " << seed << endl;
+        recordLastTime = GetTime();
+        return true;
+    }
+
+    void recordInputEvent(const InputEvent& event)
+    {
+        if (!recordFile.is_open())
             return;
 
-        playCardSelectSound();
+        // The gap since the previous event, from the times the events were
+        // read, not when a frame got round to handling them
+        double wait = event.time - recordLastTime;
+        if (wait > 0)
+            recordFile << "wait " << (float)wait << endl;
+        if (event.time > recordLastTime)
+            recordLastTime = event.time;
 
-        // Handle King selection
-        if (isKing(card))
+        if (event.type == INPUT_CLICK)
+            recordFile << "click " << event.x << " " << event.y << endl;
+        else
+            recordFile << "key " << inputKeyName(event.key) << endl;
+    }
+
+    // FNV-1a over everything that defines the game position, so two runs
+    // of the same replay can be compared with one number
+    unsigned long long stateHash()
+    {
+        unsigned long long hash = 14695981039346656037ULL;
+        int fields[12] = { (int)currentState, score, moves, gameWon, gameLost, isPaused,
+            stockTop, wasteTop,
+            currentWasteCard ? currentWasteCard->position : -1,
+            selectedCard1 ? selectedCard1->position : -1,
+            selectedCard2 ? selectedCard2->position : -1,
+            (int)dealSeed };
+
+        for (int i = 0; i < 12; i++)
         {
-            selectedCard1 = card;
-            selectedPyramid1 = pc;
-            selectedCard2 = nullptr;
-            selectedPyramid2 = nullptr;
-            removeCards();
-            return;
+            hash = (hash ^ (unsigned int)fields[i]) * 1099511628211ULL;
+        }
+        for (int i = 0; i < 52; i++)
+        {
+            int packed = allCards[i].value | (allCards[i].suit << 4)
+                | (allCards[i].faceUp << 6) | (allCards[i].inPlay << 7);
+            hash = (hash ^ (unsigned int)packed) * 1099511628211ULL;
+        }
+        for (int i = 0; i <= stockTop; i++)
+        {
+            hash = (hash ^ (unsigned int)stockArray[i]->position) * 1099511628211ULL;
         }
+        for (int i = 0; i <= wasteTop; i++)
+        {
+            hash = (hash ^ (unsigned int)wasteArray[i]->position) * 1099511628211ULL;
+        }
+        return hash;
+    }
 
-        // Handle regular card selection
-        if (!selectedCard1)
+    int getScore()
+    {
+        return score;
+    }
+
+    bool isGameWon()
+    {
+        return gameWon;
+    }
+
+    bool isGameLost()
+    {
+        return gameLost;
+    }
+};
+
+PyramidSolitaire* PyramidSolitaire::windowInput = NULL;
+GLFWmousebuttonfun PyramidSolitaire::raylibMouseButtonCallback = NULL;
+GLFWkeyfun PyramidSolitaire::raylibKeyCallback = NULL;
+
+/* ============================================================
+ * PYRAMID SOLVER (regression corpus + nodes-per-second benchmark)
+ * ============================================================
+ *
+ * Breadth-first search over compact game states, so the first win found
+ * uses the fewest moves (a move is one removal or one stock click, the
+ * same as a click in the game; a click on the empty stock recycles the
+ * waste and draws in one go).
+ *
+ * State (57 bits packed in one unsigned long long):
+ *   bits  0-27  pyramid cards removed (row by row, same order as allCards)
+ *   bits 28-51  stock cards removed (bit k = k-th card drawn, allCards[51 - k])
+ *   bits 52-56  draw pointer: cards before it are on the waste, the rest
+ *               are still in the stock (recycling keeps the draw order)
+ *
+ * Visited states live in an open-addressing hash table. The BST above is
+ * a poor fit here: millions of inserts of near-sequential keys would
+ * degenerate it into a list, while hashing stays O(1).
+ * ============================================================ */
+
+class SolverStateTable
+{
+private:
+    unsigned long long* slots; // key + 1, 0 = empty
+    long long capacity;
+    long long count;
+    long long peakBytes;
+
+    static unsigned long long mix(unsigned long long key)
+    {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    void placeNoCheck(unsigned long long stored)
+    {
+        long long mask = capacity - 1;
+        long long i = (long long)(mix(stored) & mask);
+        while (slots[i] != 0)
         {
-            selectedCard1 = card;
-            selectedPyramid1 = pc;
+            i = (i + 1) & mask;
         }
-        else if (selectedCard1 == card)
+        slots[i] = stored;
+    }
+
+    void grow()
+    {
+        unsigned long long* oldSlots = slots;
+        long long oldCapacity = capacity;
+
+        capacity *= 2;
+        slots = new unsigned long long[capacity]();
+        for (long long i = 0; i < oldCapacity; i++)
         {
-            // Deselect if clicking same card
-            selectedCard1 = nullptr;
-            selectedPyramid1 = nullptr;
+            if (oldSlots[i] != 0)
+                placeNoCheck(oldSlots[i]);
         }
-        else
+        delete[] oldSlots;
+
+        if (capacity * (long long)sizeof(unsigned long long) > peakBytes)
+            peakBytes = capacity * (long long)sizeof(unsigned long long);
+    }
+
+public:
+    SolverStateTable()
+    {
+        capacity = 1 << 16;
+        slots = new unsigned long long[capacity]();
+        count = 0;
+        peakBytes = capacity * (long long)sizeof(unsigned long long);
+    }
+
+    ~SolverStateTable()
+    {
+        delete[] slots;
+    }
+
+    // Returns false if the state was already visited
+    bool insert(unsigned long long key)
+    {
+        if ((count + 1) * 2 > capacity)
+            grow();
+
+        unsigned long long stored = key + 1;
+        long long mask = capacity - 1;
+        long long i = (long long)(mix(stored) & mask);
+        while (slots[i] != 0)
         {
-            selectedCard2 = card;
-            selectedPyramid2 = pc;
-            removeCards();
+            if (slots[i] == stored)
+                return false;
+            i = (i + 1) & mask;
         }
+        slots[i] = stored;
+        count++;
+        return true;
     }
 
-    void checkWinCondition()
+    long long getCount()
     {
-        bool allRemoved = true;
+        return count;
+    }
 
-        for (int i = 0; i < 28; i++)
+    long long getPeakBytes()
+    {
+        return peakBytes;
+    }
+};
+
+// Growable array used as one BFS frontier
+class SolverFrontier
+{
+private:
+    unsigned long long* items;
+    long long capacity;
+    long long size;
+
+public:
+    SolverFrontier()
+    {
+        capacity = 1024;
+        items = new unsigned long long[capacity];
+        size = 0;
+    }
+
+    ~SolverFrontier()
+    {
+        delete[] items;
+    }
+
+    void push(unsigned long long item)
+    {
+        if (size == capacity)
         {
-            if (allPyramidCards[i].card && allPyramidCards[i].card->inPlay)
-            {
-                allRemoved = false;
-                break;
-            }
+            unsigned long long* bigger = new unsigned long long[capacity * 2];
+            memcpy(bigger, items, size * sizeof(unsigned long long));
+            delete[] items;
+            items = bigger;
+            capacity *= 2;
         }
+        items[size++] = item;
+    }
 
-        if (allRemoved)
+    unsigned long long get(long long index)
+    {
+        return items[index];
+    }
+
+    long long getSize()
+    {
+        return size;
+    }
+
+    long long getBytes()
+    {
+        return capacity * (long long)sizeof(unsigned long long);
+    }
+
+    void clear()
+    {
+        size = 0;
+    }
+
+    void swapWith(SolverFrontier& other)
+    {
+        unsigned long long* tempItems = items;
+        items = other.items;
+        other.items = tempItems;
+
+        long long tempCapacity = capacity;
+        capacity = other.capacity;
+        other.capacity = tempCapacity;
+
+        long long tempSize = size;
+        size = other.size;
+        other.size = tempSize;
+    }
+};
+
+struct SolverResult
+{
+    bool solvable;
+    int optimalMoves; // -1 when not solvable
+    long long nodes;
+    long long peakTableBytes;
+    double seconds;
+};
+
+class PyramidSolver
+{
+private:
+    static const unsigned int ALL_PYRAMID = 0xFFFFFFF;
+    static const unsigned int STOCK_MASK = 0xFFFFFF;
+
+    int values[52];
+    int leftChild[28];
+    int rightChild[28];
+
+    SolverStateTable* table;
+    SolverFrontier* next;
+
+    static unsigned long long pack(unsigned int pyramid, unsigned int stock, int pointer)
+    {
+        return (unsigned long long)pyramid
+            | ((unsigned long long)stock << 28)
+            | ((unsigned long long)pointer << 52);
+    }
+
+    // Waste top = last drawn stock card that is still in play, or -1
+    static int wasteTop(unsigned int stock, int pointer)
+    {
+        for (int k = pointer - 1; k >= 0; k--)
         {
-            gameWon = true;
-            saveCurrentGameScore();
-            deleteSavedGame();
+            if (!(stock >> k & 1))
+                return k;
         }
+        return -1;
     }
 
-    void checkLoseCondition()
+    void visit(unsigned int pyramid, unsigned int stock, int pointer)
     {
-        if (stockTop >= 0)
+        // Normalise the pointer so equivalent waste/stock splits share a key
+        pointer = wasteTop(stock, pointer) + 1;
+
+        unsigned long long key = pack(pyramid, stock, pointer);
+        if (table->insert(key))
+            next->push(key);
+    }
+
+    void expand(unsigned long long state)
+    {
+        unsigned int pyramid = (unsigned int)(state & ALL_PYRAMID);
+        unsigned int stock = (unsigned int)((state >> 28) & STOCK_MASK);
+        int pointer = (int)((state >> 52) & 31);
+
+        int freeCards[28];
+        int freeCount = 0;
+        for (int i = 0; i < 28; i++)
         {
-            return; // Stock has cards = game continues
+            if (pyramid >> i & 1)
+                continue;
+            if (leftChild[i] < 0 || ((pyramid >> leftChild[i] & 1) && (pyramid >> rightChild[i] & 1)))
+                freeCards[freeCount++] = i;
         }
 
-        Card* accessibleCards[29];
-        int accessibleCount = 0;
+        int waste = wasteTop(stock, pointer);
+        int wasteValue = (waste >= 0) ? values[51 - waste] : 0;
 
-        // Collect ONLY free (unblocked) pyramid cards
-        for (int i = 0; i < 28; i++)
+        for (int a = 0; a < freeCount; a++)
         {
-            if (isCardFree(&allPyramidCards[i]))
+            int i = freeCards[a];
+            if (values[i] == 13)
+                visit(pyramid | (1u << i), stock, pointer);
+
+            for (int b = a + 1; b < freeCount; b++)
             {
-                accessibleCards[accessibleCount++] = allPyramidCards[i].card;
+                if (values[i] + values[freeCards[b]] == 13)
+                    visit(pyramid | (1u << i) | (1u << freeCards[b]), stock, pointer);
             }
-        }
 
-        // Add ONLY current waste card (top of waste pile)
-        if (currentWasteCard && currentWasteCard->inPlay)
-        {
-            accessibleCards[accessibleCount++] = currentWasteCard;
+            if (waste >= 0 && values[i] + wasteValue == 13)
+                visit(pyramid | (1u << i), stock | (1u << waste), pointer);
         }
 
-        // If no accessible cards at all, game is lost
-        if (accessibleCount == 0)
-        {
-            gameLost = true;
-            saveCurrentGameScore();
-            deleteSavedGame();
-            return;
-        }
+        if (waste >= 0 && wasteValue == 13)
+            visit(pyramid, stock | (1u << waste), pointer);
 
-        // Check if any King exists in accessible cards
-        for (int i = 0; i < accessibleCount; i++)
+        // Stock click: draw the next card, or recycle and draw the first one
+        int drawn = -1;
+        for (int k = pointer; k < 24; k++)
         {
-            if (isKing(accessibleCards[i]))
+            if (!(stock >> k & 1))
             {
-                return; // Valid move exists (can remove King)
+                drawn = k;
+                break;
             }
         }
-
-        // Check if any two accessible cards sum to 13
-        for (int i = 0; i < accessibleCount; i++)
+        if (drawn < 0)
         {
-            for (int j = i + 1; j < accessibleCount; j++)
+            for (int k = 0; k < pointer; k++)
             {
-                if (isValidMove(accessibleCards[i], accessibleCards[j]))
+                if (!(stock >> k & 1))
                 {
-                    return; // Valid move exists (can remove pair)
+                    drawn = k;
+                    break;
                 }
             }
         }
-
-        // Stock empty + no valid moves = GAME LOST
-        gameLost = true;
-        saveCurrentGameScore();
-        deleteSavedGame();
+        if (drawn >= 0)
+            visit(pyramid, stock, drawn + 1);
     }
 
-    void handleMouseClick(int mouseX, int mouseY)
+public:
+    PyramidSolver(Card* deal)
     {
-        if (gameWon || gameLost)
-            return;
-
-        // Check pyramid cards (using BST structure)
-        for (int i = 0; i < 28; i++)
+        for (int i = 0; i < 52; i++)
         {
-            PyramidCard& pc = allPyramidCards[i];
-            if (pc.card && pc.card->inPlay)
-            {
-                Rectangle cardRect = getPyramidCardRect(pc.row, pc.col);
-                if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, cardRect))
-                {
-                    selectCard(pc.card, &pc);
-                    return;
-                }
-            }
+            values[i] = deal[i].value;
         }
 
-        // Check waste pile
-        if (currentWasteCard && currentWasteCard->inPlay)
+        int index = 0;
+        for (int row = 0; row < 7; row++)
         {
-            int uiStartY = 150 + 7 * (CARD_HEIGHT / 2 + CARD_SPACING);
-            Rectangle wasteRect = { 50, (float)uiStartY, CARD_WIDTH, CARD_HEIGHT };
-            if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, wasteRect))
+            for (int col = 0; col <= row; col++)
             {
-                selectCard(currentWasteCard, nullptr);
-                return;
+                int childRowStart = (row + 1) * (row + 2) / 2;
+                leftChild[index] = (row < 6) ? childRowStart + col : -1;
+                rightChild[index] = (row < 6) ? childRowStart + col + 1 : -1;
+                index++;
             }
         }
 
-        // Check stock pile
-        if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, stockRect))
-        {
-            drawCardFromStock();
-            selectedCard1 = nullptr;
-            selectedCard2 = nullptr;
-            selectedPyramid1 = nullptr;
-            selectedPyramid2 = nullptr;
-            return;
-        }
+        table = NULL;
+        next = NULL;
     }
 
-    Rectangle getPyramidCardRect(int row, int col)
+    SolverResult solve()
     {
-        int startX = (GetScreenWidth() / 2) - (row * (CARD_WIDTH + CARD_SPACING) / 2);
-        int x = startX + col * (CARD_WIDTH + CARD_SPACING);
-        int y = 100 + row * (CARD_HEIGHT / 2 + CARD_SPACING);
-        return { (float)x, (float)y, (float)CARD_WIDTH, (float)CARD_HEIGHT };
-    }
+        SolverResult result;
+        result.solvable = false;
+        result.optimalMoves = -1;
+        result.nodes = 0;
 
-    void drawCard(Card* card, Rectangle rect, bool selected)
-    {
-        if (!card)
-            return;
+        auto start = chrono::steady_clock::now();
 
-        if (!card->faceUp)
-        {
-            DrawRectangleRec(rect, DARKBLUE);
-            DrawRectangleLinesEx(rect, 2, BLACK);
-            DrawText("?", rect.x + rect.width / 2 - 10, rect.y + rect.height / 2 - 10, 30, WHITE);
-            return;
-        }
+        SolverStateTable visited;
+        SolverFrontier current;
+        SolverFrontier upcoming;
+        table = &visited;
+        next = &upcoming;
 
-        Texture2D tex = cardTextures[card->suit][card->value - 1];
+        long long peakFrontierBytes = 0;
+        int depth = 0;
 
-        if (tex.id != 0)
-        {
-            DrawTexturePro(tex, { 0, 0, (float)tex.width, (float)tex.height },
-                rect, { 0, 0 }, 0, WHITE);
-        }
-        else
+        visited.insert(0);
+        current.push(0);
+
+        while (current.getSize() > 0 && !result.solvable)
         {
-            Color suitColor = (card->suit == 0 || card->suit == 1) ? RED : BLACK;
-            DrawRectangleRec(rect, WHITE);
-            DrawRectangleLinesEx(rect, 2, BLACK);
+            upcoming.clear();
+            for (long long i = 0; i < current.getSize(); i++)
+            {
+                unsigned long long state = current.get(i);
+                result.nodes++;
 
-            const char* values[13] = { "A", "2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K" };
-            DrawText(values[card->value - 1], rect.x + 10, rect.y + 10, 20, suitColor);
+                if ((state & ALL_PYRAMID) == ALL_PYRAMID)
+                {
+                    result.solvable = true;
+                    result.optimalMoves = depth;
+                    break;
+                }
 
-            const char* suitSymbols[4] = { "♥️", "♦️", "♣️", "♠️" };
-            DrawText(suitSymbols[card->suit], rect.x + 10, rect.y + 35, 25, suitColor);
-        }
+                expand(state);
+            }
 
-        if (selected)
-        {
-            DrawRectangleLinesEx(rect, 3, YELLOW);
+            if (current.getBytes() + upcoming.getBytes() > peakFrontierBytes)
+                peakFrontierBytes = current.getBytes() + upcoming.getBytes();
+
+            current.swapWith(upcoming);
+            depth++;
         }
+
+        result.peakTableBytes = visited.getPeakBytes() + peakFrontierBytes;
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        table = NULL;
+        next = NULL;
+        return result;
     }
+};
 
-    void drawBackground()
+// Runs every deal of the corpus and compares against the recorded answers.
+// Corpus lines: "<seed> <solvable 0/1> <optimal moves or -1>", '#' = comment.
+// Each deal is solved `repeats` times and the fastest run is reported, so
+// nodes/sec is comparable between runs. Returns the number of mismatches.
+int runSolverBenchmark(const char* corpusPath, const char* resultsPath, int repeats)
+{
+    ifstream corpus(corpusPath);
+    if (!corpus.is_open())
     {
-        if (background.id != 0)
-        {
-            DrawTexturePro(background,
-                { 0, 0, (float)background.width, (float)background.height },
-                { 0, 0, (float)GetScreenWidth(), (float)GetScreenHeight() },
-                { 0, 0 }, 0, WHITE);
-        }
-        else
-        {
-            ClearBackground(DARKGREEN);
-        }
+        cout << "Error: Could not open solver corpus " << corpusPath << endl;
+        return -1;
     }
 
-    void renderHighScores()
+    ofstream results;
+    if (resultsPath && resultsPath[0] != '\0')
     {
-        BeginDrawing();
-        drawBackground();
-
-        int sw = GetScreenWidth();
-        int sh = GetScreenHeight();
-
-        DrawRectangle(0, 0, sw, sh, { 0, 0, 0, 150 });
-        DrawText("TOP 5 HIGH SCORES", sw / 2 - 180, 100, 40, GOLD);
+        results.open(resultsPath, ios::app);
+        // Appending: the header only goes at the top of a new file
+        if (results.is_open() && results.tellp() == 0)
+            results << "seed,solvable,optimal_moves,nodes,nodes_per_sec,peak_tt_bytes,solve_ms,status" << endl;
+    }
 
-        for (int i = 0; i < highScoreCount; i++)
-        {
-            DrawText(TextFormat("%d. %d", i + 1, highScores[i]), sw / 2 - 50, 200 + i * 60, 35, WHITE);
-        }
+    int failures = 0;
+    int deals = 0;
+    long long totalNodes = 0;
+    double totalSeconds = 0.0;
 
-        if (highScoreCount == 0)
-        {
-            DrawText("No scores yet!", sw / 2 - 80, 200, 30, WHITE);
-        }
+    cout << "seed       solvable  moves  nodes       nodes/sec    peak TT KB  ms        status" << endl;
 
-        Rectangle backBtn = { (float)(sw / 2 - 100), sh - 120.0f, 200, 50 };
-        DrawRectangleRec(backBtn, DARKGRAY);
-        DrawRectangleLinesEx(backBtn, 2, WHITE);
-        DrawText("BACK TO MENU", sw / 2 - 85, sh - 105, 20, WHITE);
+    string line;
+    while (getline(corpus, line))
+    {
+        if (line.empty() || line[0] == '#' || line[0] == '\r')
+            continue;
 
-        EndDrawing();
-    }
+        unsigned int seed = 0;
+        int expectedSolvable = 0;
+        int expectedMoves = 0;
+        if (sscanf(line.c_str(), "%u %d %d", &seed, &expectedSolvable, &expectedMoves) != 3)
+            continue;
 
-    void handleHighScoresClick(int mouseX, int mouseY)
-    {
-        int sw = GetScreenWidth();
-        int sh = GetScreenHeight();
+        Card deal[52];
+        dealShuffledDeck(deal, seed);
 
-        Rectangle backBtn = { (float)(sw / 2 - 100), sh - 120.0f, 200, 50 };
-        if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, backBtn))
+        SolverResult best = {};
+        for (int r = 0; r < repeats; r++)
         {
-            currentState = MAIN_MENU;
+            PyramidSolver solver(deal);
+            SolverResult run = solver.solve();
+            if (r == 0 || run.seconds < best.seconds)
+                best = run;
         }
-    }
-
-    void renderMainMenu()
-    {
-        BeginDrawing();
-        drawBackground();
-
-        int sw = GetScreenWidth();
-        int sh = GetScreenHeight();
 
-        DrawText("PYRAMID SOLITAIRE", sw / 2 - 250, sh / 2 - 300, 50, GOLD);
+        bool ok = (best.solvable == (expectedSolvable != 0)) && (best.optimalMoves == expectedMoves);
+        if (!ok)
+            failures++;
 
-        Rectangle playBtn = { (float)(sw / 2 - 150), (float)(sh / 2 - 180), 300, 60 };
-        Rectangle loadBtn = { (float)(sw / 2 - 150), (float)(sh / 2 - 90), 300, 60 };
-        Rectangle instructBtn = { (float)(sw / 2 - 150), (float)(sh / 2), 300, 60 };
-        Rectangle highScoreBtn = { (float)(sw / 2 - 150), (float)(sh / 2 + 90), 300, 60 };
-        Rectangle exitBtn = { (float)(sw / 2 - 150), (float)(sh / 2 + 180), 300, 60 };
+        double nodesPerSec = (best.seconds > 0) ? best.nodes / best.seconds : 0.0;
+        deals++;
+        totalNodes += best.nodes;
+        totalSeconds += best.seconds;
 
-        DrawRectangleRec(playBtn, DARKGREEN);
-        DrawRectangleLinesEx(playBtn, 3, GREEN);
-        DrawText("NEW GAME", sw / 2 - 110, sh / 2 - 160, 25, WHITE);
+        cout << TextFormat("%-10u %-9s %-6d %-11lld %-12.0f %-11lld %-9.1f %s",
+            seed, best.solvable ? "yes" : "no", best.optimalMoves, best.nodes, nodesPerSec,
+            best.peakTableBytes / 1024, best.seconds * 1000.0, ok ? "OK" : "MISMATCH") << endl;
 
-        if (savedGameExists)
+        if (!ok)
         {
-            DrawRectangleRec(loadBtn, PURPLE);
-            DrawRectangleLinesEx(loadBtn, 3, VIOLET);
-            DrawText("LOAD GAME", sw / 2 - 110, sh / 2 - 70, 25, WHITE);
+            cout << "  expected solvable=" << expectedSolvable << " moves=" << expectedMoves << endl;
         }
-        else
+
+        if (results.is_open())
         {
-            DrawRectangleRec(loadBtn, DARKGRAY);
-            DrawRectangleLinesEx(loadBtn, 3, GRAY);
-            DrawText("LOAD GAME", sw / 2 - 110, sh / 2 - 70, 25, GRAY);
+            results << seed << "," << (best.solvable ? 1 : 0) << "," << best.optimalMoves << ","
+                << best.nodes << "," << (long long)nodesPerSec << "," << best.peakTableBytes << ","
+                << best.seconds * 1000.0 << "," << (ok ? "OK" : "MISMATCH") << endl;
         }
-
-        DrawRectangleRec(instructBtn, DARKBLUE);
-        DrawRectangleLinesEx(instructBtn, 3, BLUE);
-        DrawText("INSTRUCTIONS", sw / 2 - 110, sh / 2 + 20, 25, WHITE);
-
-        DrawRectangleRec(highScoreBtn, ORANGE);
-        DrawRectangleLinesEx(highScoreBtn, 3, RED);
-        DrawText("HIGH SCORES", sw / 2 - 100, sh / 2 + 110, 25, WHITE);
-
-        DrawRectangleRec(exitBtn, DARKGRAY);
-        DrawRectangleLinesEx(exitBtn, 3, BLACK);
-        DrawText("EXIT GAME", sw / 2 - 80, sh / 2 + 200, 25, WHITE);
-
-        EndDrawing();
     }
 
-    void renderInstructions()
+    if (totalSeconds > 0)
     {
-        BeginDrawing();
-        drawBackground();
-
-        int sw = GetScreenWidth();
-        int sh = GetScreenHeight();
-
-        DrawRectangle(sw / 2 - 400, 100, 800, 700, { 0, 0, 0, 200 });
-        DrawRectangleLinesEx({ (float)(sw / 2 - 400), 100, 800, 700 }, 3, GOLD);
-
-        DrawText("HOW TO PLAY PYRAMID SOLITAIRE", sw / 2 - 280, 130, 30, GOLD);
-
-        int y = 190;
-        int spacing = 35;
-
-        DrawText("OBJECTIVE:", sw / 2 - 350, y, 25, YELLOW);
-        y += spacing;
-        DrawText("Remove all cards from the pyramid by pairing cards", sw / 2 - 350, y, 20, WHITE);
-        y += spacing - 5;
-        DrawText("that add up to 13.", sw / 2 - 350, y, 20, WHITE);
-        y += spacing + 10;
+        cout << deals << " deals, " << totalNodes << " nodes, "
+            << (long long)(totalNodes / totalSeconds) << " nodes/sec overall, "
+            << failures << " mismatches" << endl;
+    }
 
-        DrawText("RULES:", sw / 2 - 350, y, 25, YELLOW);
-        y += spacing;
-        DrawText("1. Only uncovered cards can be selected.", sw / 2 - 350, y, 20, WHITE);
-        y += spacing + 5;
-        DrawText("2. Pair two cards that sum to 13:", sw / 2 - 350, y, 20, WHITE);
-        y += spacing - 5;
-        DrawText("   Ace(1) + Queen(12), 2 + Jack(11), 3 + 10,", sw / 2 - 350, y, 20, WHITE);
-        y += spacing - 5;
-        DrawText("   4 + 9, 5 + 8, 6 + 7", sw / 2 - 350, y, 20, WHITE);
-        y += spacing + 5;
-        DrawText("3. Kings (13) can be removed individually.", sw / 2 - 350, y, 20, WHITE);
-        y += spacing + 5;
-        DrawText("4. Click STOCK to draw (unlimited draws).", sw / 2 - 350, y, 20, WHITE);
-        y += spacing + 5;
-        DrawText("5. Stock recycles automatically when empty.", sw / 2 - 350, y, 20, WHITE);
-        y += spacing + 10;
+    return failures;
+}
 
-        DrawText("CONTROLS:", sw / 2 - 350, y, 25, YELLOW);
-        y += spacing;
-        DrawText("P - Pause/Resume game", sw / 2 - 350, y, 20, WHITE);
-        y += spacing;
-        DrawText("S - Save current game", sw / 2 - 350, y, 20, WHITE);
-        y += spacing;
-        DrawText("BACKSPACE - Return to main menu (auto-saves)", sw / 2 - 350, y, 20, WHITE);
-        y += spacing + 10;
+/* ============================================================
+ * HARDWARE PERFORMANCE COUNTERS (benchmark harness)
+ * ============================================================
+ * Linux only: uses perf_event_open to count cycles, instructions,
+ * L1 data cache read misses, last-level cache misses and branch misses
+ * for the current thread (user space only). On other platforms, or when
+ * the kernel refuses access (see /proc/sys/kernel/perf_event_paranoid),
+ * the counters report as unavailable and only wall time is printed.
+ * ============================================================ */
 
-        DrawText("SCORING:", sw / 2 - 350, y, 25, YELLOW);
-        y += spacing;
-        DrawText("King removed: +10 points", sw / 2 - 350, y, 20, WHITE);
-        y += spacing - 5;
-        DrawText("Pair removed: +20 points", sw / 2 - 350, y, 20, WHITE);
+enum PerfCounterId
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTER_COUNT
+};
 
-        Rectangle backBtn = { (float)(sw / 2 - 100), (float)(sh - 120), 200, 50 };
-        DrawRectangleRec(backBtn, DARKGRAY);
-        DrawRectangleLinesEx(backBtn, 2, WHITE);
-        DrawText("BACK TO MENU", sw / 2 - 85, sh - 105, 20, WHITE);
+class PerfCounters
+{
+private:
+    int fds[PERF_COUNTER_COUNT];
+    long long values[PERF_COUNTER_COUNT];
+    chrono::steady_clock::time_point startTime;
+    double seconds;
 
-        EndDrawing();
+#ifdef __linux__
+    static int openCounter(unsigned int type, unsigned long long config)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
     }
+#endif
 
-    void handleMainMenuClick(int mouseX, int mouseY)
+public:
+    PerfCounters()
     {
-        int sw = GetScreenWidth();
-        int sh = GetScreenHeight();
-
-        Rectangle playBtn = { (float)(sw / 2 - 150), (float)(sh / 2 - 180), 300, 60 };
-        Rectangle loadBtn = { (float)(sw / 2 - 150), (float)(sh / 2 - 90), 300, 60 };
-        Rectangle instructBtn = { (float)(sw / 2 - 150), (float)(sh / 2), 300, 60 };
-        Rectangle highScoreBtn = { (float)(sw / 2 - 150), (float)(sh / 2 + 90), 300, 60 };
-        Rectangle exitBtn = { (float)(sw / 2 - 150), (float)(sh / 2 + 180), 300, 60 };
-
-        if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, playBtn))
-        {
-            initGame();
-        }
-        else if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, loadBtn) && savedGameExists)
-        {
-            loadGame();
-        }
-        else if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, instructBtn))
+        seconds = 0.0;
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
         {
-            currentState = INSTRUCTIONS;
+            fds[i] = -1;
+            values[i] = -1;
         }
-        else if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, highScoreBtn))
+
+#ifdef __linux__
+        fds[PERF_CYCLES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        fds[PERF_INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        fds[PERF_L1D_MISSES] = openCounter(PERF_TYPE_HW_CACHE,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        fds[PERF_LLC_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        fds[PERF_BRANCH_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+    }
+
+    ~PerfCounters()
+    {
+#ifdef __linux__
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
         {
-            currentState = HIGH_SCORES;
+            if (fds[i] >= 0)
+                close(fds[i]);
         }
-        else if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, exitBtn))
+#endif
+    }
+
+    bool isAvailable()
+    {
+        return fds[PERF_CYCLES] >= 0;
+    }
+
+    // Resets the counters and starts counting
+    void start()
+    {
+        seconds = 0.0;
+#ifdef __linux__
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
         {
-            CloseWindow();
-            exit(0);
+            if (fds[i] >= 0)
+                ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
         }
+#endif
+        resume();
     }
 
-    void handleInstructionsClick(int mouseX, int mouseY)
+    // pause()/resume() exclude setup work (e.g. refilling a list) between
+    // measured sections; the counts keep accumulating until stop()
+    void pause()
     {
-        int sw = GetScreenWidth();
-        int sh = GetScreenHeight();
-
-        Rectangle backBtn = { (float)(sw / 2 - 100), (float)(sh - 120), 200, 50 };
-        if (CheckCollisionPointRec({ (float)mouseX, (float)mouseY }, backBtn))
+#ifdef __linux__
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
         {
-            currentState = MAIN_MENU;
+            if (fds[i] >= 0)
+                ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
         }
+#endif
+        seconds += chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
     }
 
-    void render()
+    void resume()
     {
-        if (currentState == HIGH_SCORES)
+        startTime = chrono::steady_clock::now();
+#ifdef __linux__
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
         {
-            renderHighScores();
-            return;
+            if (fds[i] >= 0)
+                ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
         }
+#endif
+    }
 
-        if (currentState == MAIN_MENU)
+    void stop()
+    {
+        pause();
+#ifdef __linux__
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
         {
-            renderMainMenu();
-            return;
+            values[i] = -1;
+            long long count = 0;
+            if (fds[i] >= 0 && read(fds[i], &count, sizeof(count)) == sizeof(count))
+                values[i] = count;
         }
+#endif
+    }
 
-        if (currentState == INSTRUCTIONS)
+    // Prints one line with every counter divided by the number of operations
+    void report(const char* name, long long operations)
+    {
+        if (operations <= 0)
+            operations = 1;
+
+        const char* labels[PERF_COUNTER_COUNT] = { "cycles", "instr", "L1d-miss", "LLC-miss", "br-miss" };
+
+        cout << TextFormat("%-28s %10.1f ns/op", name, seconds * 1e9 / operations);
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
         {
-            renderInstructions();
-            return;
+            if (values[i] >= 0)
+                cout << TextFormat("  %s %.2f", labels[i], (double)values[i] / operations);
+            else
+                cout << "  " << labels[i] << " n/a";
         }
+        if (values[PERF_CYCLES] > 0 && values[PERF_INSTRUCTIONS] >= 0)
+            cout << TextFormat("  IPC %.2f", (double)values[PERF_INSTRUCTIONS] / values[PERF_CYCLES]);
+        cout << endl;
+    }
+};
 
-        BeginDrawing();
-        drawBackground();
+/* ============================================================
+ * MEMORY FOOTPRINT REPORT (--mem-report)
+ * ============================================================
+ * Static sizes come from sizeof; heap sizes are node counts times node
+ * size, plus an estimate of the allocator's per-block overhead (glibc
+ * malloc, see heapBlockBytes). Resident
+ * set sizes are read from /proc/self/status and are Linux only.
+ * ============================================================ */
+
+// field = "VmRSS:" (current) or "VmHWM:" (peak); returns KB, -1 if unknown
+long long readProcessMemoryKB(const char* field)
+{
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line))
+    {
+        if (line.compare(0, strlen(field), field) == 0)
+            return atoll(line.c_str() + strlen(field));
+    }
+    return -1;
+}
+
+void runMemoryReport(int games)
+{
+    {
+        PyramidSolitaire sample(true);
+        sample.initGame();
+        sample.printMemoryFootprint();
+    }
 
-        int sw = GetScreenWidth();
-        int sh = GetScreenHeight();
+    long long baselineKB = readProcessMemoryKB("VmRSS:");
 
-        DrawText(TextFormat("Score: %d", score), 20, 20, 25, GOLD);
-        DrawText(TextFormat("Moves: %d", moves), sw - 150, 20, 25, YELLOW);
+    PyramidSolitaire** liveGames = new PyramidSolitaire*[games];
+    for (int i = 0; i < games; i++)
+    {
+        liveGames[i] = new PyramidSolitaire(true);
+        liveGames[i]->initGame();
+    }
 
-        // Draw pyramid cards (managed by BST)
-        for (int i = 0; i < 28; i++)
-        {
-            PyramidCard& pc = allPyramidCards[i];
-            if (pc.card && pc.card->inPlay)
-            {
-                Rectangle rect = getPyramidCardRect(pc.row, pc.col);
-                bool selected = (&pc == selectedPyramid1 || &pc == selectedPyramid2);
-                drawCard(pc.card, rect, selected);
+    long long peakKB = readProcessMemoryKB("VmHWM:");
+    long long liveKB = readProcessMemoryKB("VmRSS:");
 
-                // Draw red line on blocked cards
-                if (pc.blocked)
-                {
-                    DrawRectangle(rect.x, rect.y, rect.width, 5, RED);
-                }
-            }
-        }
+    cout << endl << games << " concurrent in-memory games:" << endl;
+    if (baselineKB < 0 || peakKB < 0)
+    {
+        cout << "  RSS not available on this platform" << endl;
+    }
+    else
+    {
+        double perGameBytes = (liveKB - baselineKB) * 1024.0 / games;
+        cout << "  RSS before " << baselineKB << " KB, with games " << liveKB
+            << " KB, peak " << peakKB << " KB" << endl;
+        cout << "  measured " << (long long)perGameBytes << " bytes per game";
+        if (perGameBytes > 0)
+            cout << ", about " << (long long)(1073741824.0 / perGameBytes) << " games per GB";
+        cout << endl;
+    }
+
+    for (int i = 0; i < games; i++)
+    {
+        delete liveGames[i];
+    }
+    delete[] liveGames;
+}
+
+/* ============================================================
+ * INPUT REPLAY (--replay)
+ * ============================================================
+ * Feeds a recorded input file into a headless game as fast as possible
+ * and measures how long each event takes from processInputEvent() to the
+ * new game state (handleMouseClick -> selectCard -> removeCards ...).
+ * File format, one command per line ('#' = comment):
+ *   seed <n>          deal games from seed n, n + 1, ...
+ *   new               start a new game (like NEW GAME in the menu)
+ *   click <x> <y>     left click at window coordinates
+ *   key <S|P|BACKSPACE>
+ *   wait <seconds>    advance the game clock by that many seconds, in 1/60 s frames
+ * Files written with --record start with a seed line followed by the
+ * menu clicks, so they replay from the main menu.
+ * ============================================================ */
+
+int compareLatency(const void* a, const void* b)
+{
+    long long left = *(const long long*)a;
+    long long right = *(const long long*)b;
+    return (left < right) ? -1 : (left > right) ? 1 : 0;
+}
+
+// Replays the file once; fills latencies (ns) and returns the event count,
+// or -1 if the file could not be read
+int replayInputFile(const char* path, long long* latencies, int maxEvents, unsigned long long& finalHash, int& finalScore)
+{
+    ifstream in(path);
+    if (!in.is_open())
+    {
+        cout << "Error: Could not open replay file " << path << endl;
+        return -1;
+    }
 
-        int uiStartY = 150 + 7 * (CARD_HEIGHT / 2 + CARD_SPACING);
+    PyramidSolitaire game(true);
+    game.useSeedSequence(1);
 
-        // Draw waste pile
-        DrawText("WASTE", 50, uiStartY - 30, 20, WHITE);
-        if (currentWasteCard && currentWasteCard->inPlay)
+    int eventCount = 0;
+    int lineNumber = 0;
+    string line;
+    while (getline(in, line))
+    {
+        lineNumber++;
+        if (line.empty() || line[0] == '#' || line[0] == '\r')
+            continue;
+
+        char command[16] = { 0 };
+        char argument[16] = { 0 };
+        float x = 0;
+        float y = 0;
+        InputEvent event;
+        event.time = 0;
+        bool isEvent = false;
+
+        if (sscanf(line.c_str(), "click %f %f", &x, &y) == 2)
         {
-            Rectangle wasteRect = { 50, (float)uiStartY, CARD_WIDTH, CARD_HEIGHT };
-            bool selected = (currentWasteCard == selectedCard1 || currentWasteCard == selectedCard2);
-            drawCard(currentWasteCard, wasteRect, selected);
+            event.type = INPUT_CLICK;
+            event.key = 0;
+            event.x = x;
+            event.y = y;
+            isEvent = true;
         }
-        else
+        else if (sscanf(line.c_str(), "key %15s", argument) == 1)
         {
-            Rectangle emptyRect = { 50, (float)uiStartY, CARD_WIDTH, CARD_HEIGHT };
-            DrawRectangleLinesEx(emptyRect, 2, GRAY);
+            event.type = INPUT_KEY;
+            event.key = inputKeyCode(argument);
+            event.x = 0;
+            event.y = 0;
+            isEvent = (event.key >= 0);
+            if (!isEvent)
+                cout << "  line " << lineNumber << ": unknown key " << argument << endl;
         }
-
-        // Draw stock pile
-        stockRect = { 180.0f, (float)uiStartY, (float)CARD_WIDTH, (float)CARD_HEIGHT };
-        DrawText("STOCK", 180, uiStartY - 30, 20, WHITE);
-        DrawText(TextFormat("(%d)", stockTop + 1), 190, uiStartY + CARD_HEIGHT + 5, 18, LIGHTGRAY);
-
-        if (stockTexture.id != 0 && stockTop >= 0)
+        else if (sscanf(line.c_str(), "wait %f", &x) == 1)
+        {
+            // In frame-sized pieces, as a running game would, so long
+            // waits are not cut short by the per-frame stall limit
+            const float frame = 1.0f / 60.0f;
+            while (x > 0)
+            {
+                float step = (x < frame) ? x : frame;
+                game.advanceClock(step);
+                x -= step;
+            }
+        }
+        else if (sscanf(line.c_str(), "seed %15s", argument) == 1)
         {
-            DrawTexturePro(stockTexture,
-                { 0, 0, (float)stockTexture.width, (float)stockTexture.height },
-                stockRect, { 0, 0 }, 0, WHITE);
+            game.useSeedSequence((unsigned int)strtoul(argument, NULL, 10));
         }
-        else if (stockTop >= 0)
+        else if (sscanf(line.c_str(), "%15s", command) == 1 && strcmp(command, "new") == 0)
         {
-            DrawRectangleRec(stockRect, BLUE);
-            DrawRectangleLinesEx(stockRect, 2, WHITE);
-            DrawText("STOCK", stockRect.x + 15, stockRect.y + 55, 18, WHITE);
+            game.initGame();
         }
         else
         {
-            DrawRectangleLinesEx(stockRect, 2, GRAY);
-            DrawText("RECYCLE", stockRect.x + 8, stockRect.y + 55, 16, GRAY);
+            cout << "  line " << lineNumber << ": ignored '" << line << "'" << endl;
         }
 
-        // Draw time
-        int totalSeconds = (int)gameTime;
-        int hours = totalSeconds / 3600;
-        int minutes = (totalSeconds % 3600) / 60;
-        int seconds = totalSeconds % 60;
-        DrawText(TextFormat("Time: %02d:%02d:%02d", hours, minutes, seconds), sw / 2 - 80, sh - 30, 25, WHITE);
-
-        // Draw restart button
-        Rectangle restartBtn = { (float)(sw - 150), (float)(sh - 60), 120, 50 };
-        DrawRectangleRec(restartBtn, MAROON);
-        DrawRectangleLinesEx(restartBtn, 2, WHITE);
-        DrawText("RESTART", sw - 140, sh - 45, 20, WHITE);
+        if (isEvent && eventCount < maxEvents)
+        {
+            auto start = chrono::steady_clock::now();
+            game.processInputEvent(event);
+            latencies[eventCount++] = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        }
+    }
 
-        DrawText("Press S to Save", 20, sh - 30, 20, LIGHTGRAY);
+    finalHash = game.stateHash();
+    finalScore = game.getScore();
+    return eventCount;
+}
 
-        // Show save message
-        if (showSaveMessage && saveMessageTimer > 0)
+// Replays the file `repeats` times; every run must end in the same state
+int runInputReplay(const char* path, int repeats)
+{
+    const int MAX_EVENTS = 100000;
+    long long* latencies = new long long[MAX_EVENTS];
+    long long* allLatencies = new long long[MAX_EVENTS];
+    int allCount = 0;
+    unsigned long long firstHash = 0;
+    bool deterministic = true;
+    int eventCount = 0;
+    int finalScore = 0;
+
+    for (int r = 0; r < repeats; r++)
+    {
+        unsigned long long hash = 0;
+        eventCount = replayInputFile(path, latencies, MAX_EVENTS, hash, finalScore);
+        if (eventCount < 0)
         {
-            DrawText("GAME SAVED!", sw / 2 - 80, 60, 30, GREEN);
+            delete[] latencies;
+            delete[] allLatencies;
+            return 1;
         }
 
-        // Draw game over messages
-        if (gameWon)
+        if (r == 0)
+            firstHash = hash;
+        else if (hash != firstHash)
+            deterministic = false;
+
+        for (int i = 0; i < eventCount && allCount < MAX_EVENTS; i++)
         {
-            DrawRectangle(0, 0, sw, sh, { 0, 0, 0, 150 });
-            DrawText("YOU WIN!", sw / 2 - 100, sh / 2 - 50, 40, GOLD);
-            DrawText(TextFormat("Final Score: %d", score), sw / 2 - 100, sh / 2 + 10, 30, WHITE);
-            DrawText("Press BACKSPACE for menu", sw / 2 - 150, sh / 2 + 60, 20, LIGHTGRAY);
+            allLatencies[allCount++] = latencies[i];
         }
-        else if (gameLost)
+    }
+
+    cout << "replayed " << eventCount << " events x " << repeats << " runs from " << path << endl;
+    if (allCount > 0)
+    {
+        qsort(allLatencies, allCount, sizeof(long long), compareLatency);
+        long long total = 0;
+        for (int i = 0; i < allCount; i++)
         {
-            DrawRectangle(0, 0, sw, sh, { 0, 0, 0, 150 });
-            DrawText("NO MOVES LEFT!", sw / 2 - 150, sh / 2 - 50, 40, RED);
-            DrawText(TextFormat("Final Score: %d", score), sw / 2 - 100, sh / 2 + 10, 30, WHITE);
-            DrawText("Press BACKSPACE for menu", sw / 2 - 150, sh / 2 + 60, 20, LIGHTGRAY);
+            total += allLatencies[i];
         }
 
-        if (isPaused)
+        cout << TextFormat("latency per event (us): min %.2f  mean %.2f  p50 %.2f  p99 %.2f  max %.2f",
+            allLatencies[0] / 1000.0, total / 1000.0 / allCount, allLatencies[allCount / 2] / 1000.0,
+            allLatencies[(allCount * 99) / 100] / 1000.0, allLatencies[allCount - 1] / 1000.0) << endl;
+    }
+    cout << TextFormat("final state hash %016llx  score %d", firstHash, finalScore) << endl;
+    if (!deterministic)
+        cout << "Error: runs ended in different states" << endl;
+
+    delete[] latencies;
+    delete[] allLatencies;
+    return deterministic ? 0 : 1;
+}
+
+// Packs the card faces and the stock back into the atlas (--build-atlas).
+// Runs on the CPU only, so no window is needed. Returns 0 on success.
+int buildCardAtlas(const char* imagePath, const char* regionsPath)
+{
+    int rows = (ATLAS_CELL_COUNT + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS;
+    int cellStepX = ATLAS_CELL_WIDTH + 2 * ATLAS_PADDING;
+    int cellStepY = ATLAS_CELL_HEIGHT + 2 * ATLAS_PADDING;
+    Image atlas = GenImageColor(ATLAS_COLUMNS * cellStepX, rows * cellStepY, BLANK);
+
+    ofstream regions(regionsPath);
+    if (!regions)
+    {
+        cout << "cannot write " << regionsPath << endl;
+        UnloadImage(atlas);
+        return 1;
+    }
+    regions << "# name x y width height (pixels in " << imagePath << ")" << endl;
+
+    ImageDecodeJob jobs[ATLAS_CELL_COUNT];
+    for (int cell = 0; cell < ATLAS_CELL_COUNT; cell++)
+        jobs[cell].path = atlasCellImagePath(cell);
+    decodeImagesParallel(jobs, ATLAS_CELL_COUNT);
+
+    int missing = 0;
+    for (int cell = 0; cell < ATLAS_CELL_COUNT; cell++)
+    {
+        Image image = jobs[cell].image;
+        if (image.data == NULL)
         {
-            DrawRectangle(0, 0, sw, sh, { 0, 0, 0, 150 });
-            DrawText("PAUSED", sw / 2 - 80, sh / 2, 40, YELLOW);
-            DrawText("Press P to Resume", sw / 2 - 120, sh / 2 + 50, 25, WHITE);
+            cout << "missing " << jobs[cell].path << endl;
+            missing++;
+            continue;
         }
+        ImageResize(&image, ATLAS_CELL_WIDTH, ATLAS_CELL_HEIGHT);
+
+        // Edge pixels are repeated into the gutter so bilinear and mipmapped
+        // sampling at the region border still reads this card's colour
+        int x = (cell % ATLAS_COLUMNS) * cellStepX + ATLAS_PADDING;
+        int y = (cell / ATLAS_COLUMNS) * cellStepY + ATLAS_PADDING;
+        float w = (float)ATLAS_CELL_WIDTH;
+        float h = (float)ATLAS_CELL_HEIGHT;
+        float p = (float)ATLAS_PADDING;
+        ImageDraw(&atlas, image, { 0, 0, w, h }, { x - p, y - p, w + 2 * p, h + 2 * p }, WHITE);
+        ImageDraw(&atlas, image, { 0, 0, w, h }, { (float)x, (float)y, w, h }, WHITE);
+        UnloadImage(image);
+
+        regions << atlasCellName(cell) << " " << x << " " << y << " "
+            << ATLAS_CELL_WIDTH << " " << ATLAS_CELL_HEIGHT << endl;
+    }
 
-        EndDrawing();
+    bool exported = (missing == 0) && ExportImage(atlas, imagePath);
+    UnloadImage(atlas);
+    regions.close();
+
+    if (!exported)
+    {
+        // A partial region file would make the game draw blank cards
+        remove(regionsPath);
+        cout << "atlas not written" << endl;
+        return 1;
     }
 
-    void update(float deltaTime)
+    cout << "wrote " << imagePath << " (" << ATLAS_COLUMNS * cellStepX << "x"
+        << rows * cellStepY << ", " << ATLAS_CELL_COUNT << " cells) and "
+        << regionsPath << endl;
+    return 0;
+}
+
+// Writes the asset pack (--pack-assets): the background, the stock back,
+// the 52 faces, the atlas if one was built, and the sound effects, all
+// decoded (card images already resized and mipmapped). Missing files are
+// skipped. Returns 0 on success.
+int packAssets(const char* packPath)
+{
+    ImageDecodeJob images[2 + ATLAS_CELL_COUNT];
+    int imageCount = 0;
+    images[imageCount++].path = "images/background.jpg";
+    for (int cell = 0; cell < ATLAS_CELL_COUNT; cell++)
     {
-        // Update save message timer
-        if (showSaveMessage)
+        images[imageCount].cardImage = true;
+        images[imageCount++].path = atlasCellImagePath(cell);
+    }
+    if (FileExists(ATLAS_IMAGE_PATH))
+        images[imageCount++].path = ATLAS_IMAGE_PATH;
+
+    // Decode from the source files, never from an existing pack
+    assetPack.close();
+    decodeImagesParallel(images, imageCount);
+
+    Wave waves[SFX_COUNT];
+    for (int i = 0; i < SFX_COUNT; i++)
+        waves[i] = FileExists(soundEffectPaths[i]) ? LoadWave(soundEffectPaths[i]) : Wave{};
+
+    AssetPackEntry entries[2 + ATLAS_CELL_COUNT + SFX_COUNT];
+    const void* payloads[2 + ATLAS_CELL_COUNT + SFX_COUNT];
+    unsigned int entryCount = 0;
+    unsigned long long offset = sizeof(AssetPackHeader) + sizeof(entries);
+    auto addEntry = [&](const char* name, unsigned int kind, unsigned int a, unsigned int b,
+        unsigned int c, unsigned int d, const void* payload, unsigned long long size)
+    {
+        AssetPackEntry& entry = entries[entryCount];
+        memset(&entry, 0, sizeof(entry));
+        strncpy(entry.name, name, sizeof(entry.name) - 1);
+        entry.kind = kind;
+        entry.a = a;
+        entry.b = b;
+        entry.c = c;
+        entry.d = d;
+        offset = (offset + ASSET_PACK_ALIGN - 1) / ASSET_PACK_ALIGN * ASSET_PACK_ALIGN;
+        entry.offset = offset;
+        entry.size = size;
+        payloads[entryCount++] = payload;
+        offset += size;
+    };
+
+    for (int i = 0; i < imageCount; i++)
+    {
+        Image& image = images[i].image;
+        if (image.data == NULL)
         {
-            saveMessageTimer -= deltaTime;
-            if (saveMessageTimer <= 0)
-            {
-                showSaveMessage = false;
-            }
+            cout << "skipped " << images[i].path << " (missing)" << endl;
+            continue;
         }
-
-        // Handle backspace key
-        if (IsKeyPressed(KEY_BACKSPACE))
+        long long size = imageDataSize(image.width, image.height, image.format, image.mipmaps);
+        if (size < 0)
         {
-            if (currentState == PLAYING && !gameWon && !gameLost)
-            {
-                saveGame();
-            }
-            currentState = MAIN_MENU;
-            isPaused = false;
-            checkSavedGame();
-            return;
+            cout << "skipped " << images[i].path << " (too large)" << endl;
+            continue;
+        }
+        addEntry(images[i].path.c_str(), ASSET_IMAGE, image.width, image.height, image.format,
+            image.mipmaps, image.data, size);
+    }
+    for (int i = 0; i < SFX_COUNT; i++)
+    {
+        Wave& wave = waves[i];
+        if (wave.data == NULL)
+        {
+            cout << "skipped " << soundEffectPaths[i] << " (missing)" << endl;
+            continue;
         }
+        addEntry(soundEffectPaths[i], ASSET_WAVE, wave.frameCount, wave.sampleRate, wave.sampleSize,
+            wave.channels, wave.data, (unsigned long long)wave.frameCount * wave.channels * wave.sampleSize / 8);
+    }
 
-        // Handle high scores screen
-        if (currentState == HIGH_SCORES)
+    // The entry table is written at its full size so data offsets do not
+    // depend on how many files were found
+    AssetPackHeader header;
+    memcpy(header.magic, ASSET_PACK_MAGIC, 4);
+    header.version = ASSET_PACK_VERSION;
+    header.entryCount = entryCount;
+    header.reserved = 0;
+    for (unsigned int i = entryCount; i < sizeof(entries) / sizeof(entries[0]); i++)
+        memset(&entries[i], 0, sizeof(entries[i]));
+
+    bool written = false;
+    FILE* file = fopen(packPath, "wb");
+    if (file)
+    {
+        written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(entries, sizeof(entries), 1, file) == 1;
+        const char zeros[ASSET_PACK_ALIGN] = {};
+        for (unsigned int i = 0; written && i < entryCount; i++)
         {
-            if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON))
-            {
-                Vector2 mousePos = GetMousePosition();
-                handleHighScoresClick((int)mousePos.x, (int)mousePos.y);
-            }
-            return;
+            long padding = (long)entries[i].offset - ftell(file);
+            written = fwrite(zeros, 1, (size_t)padding, file) == (size_t)padding &&
+                fwrite(payloads[i], 1, (size_t)entries[i].size, file) == (size_t)entries[i].size;
         }
+        written = (fclose(file) == 0) && written;
+    }
 
-        // Handle main menu
-        if (currentState == MAIN_MENU)
+    for (int i = 0; i < imageCount; i++)
+    {
+        if (images[i].image.data != NULL)
+            UnloadImage(images[i].image);
+    }
+    for (int i = 0; i < SFX_COUNT; i++)
+    {
+        if (waves[i].data != NULL)
+            UnloadWave(waves[i]);
+    }
+
+    if (!written)
+    {
+        remove(packPath);
+        cout << "cannot write " << packPath << endl;
+        return 1;
+    }
+
+    cout << "wrote " << packPath << ": " << entryCount << " assets, " << offset / 1024 << " KB" << endl;
+    return 0;
+}
+
+// Micro and whole-game benchmarks with hardware counters (--perf-bench)
+void runPerfBenchmark(int iterations)
+{
+    PerfCounters counters;
+    if (!counters.isAvailable())
+        cout << "Hardware counters unavailable, reporting wall time only" << endl;
+
+    // BST<PyramidCard>::search on the 28-card pyramid, built the way createPyramid does
+    {
+        Card deal[52];
+        dealShuffledDeck(deal, 1);
+
+        BST<PyramidCard> tree;
+        PyramidCard keys[28];
+        int index = 0;
+        for (int row = 0; row < 7; row++)
         {
-            if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON))
+            for (int col = 0; col <= row; col++)
             {
-                Vector2 mousePos = GetMousePosition();
-                handleMainMenuClick((int)mousePos.x, (int)mousePos.y);
+                keys[index] = PyramidCard(&deal[index], row, col);
+                tree.insert(keys[index]);
+                index++;
             }
-            return;
         }
 
-        // Handle instructions screen
-        if (currentState == INSTRUCTIONS)
+        long long found = 0;
+        counters.start();
+        for (int it = 0; it < iterations; it++)
         {
-            if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON))
+            for (int i = 0; i < 28; i++)
             {
-                Vector2 mousePos = GetMousePosition();
-                handleInstructionsClick((int)mousePos.x, (int)mousePos.y);
+                if (tree.search(keys[i]) != NULL)
+                    found++;
             }
-            return;
         }
+        counters.stop();
+        counters.report("BST<PyramidCard>::search", (long long)iterations * 28);
 
-        // Handle save key
-        if (IsKeyPressed(KEY_S) && !gameWon && !gameLost && !isPaused)
-        {
-            saveGame();
-        }
+        if (found != (long long)iterations * 28)
+            cout << "  unexpected miss in BST search" << endl;
+    }
 
-        // Handle pause key
-        if (IsKeyPressed(KEY_P) && !gameWon && !gameLost)
+    // Whole-game simulation: seeded deals played by simulateGame()
+    {
+        PyramidSolitaire game(true);
+        int games = iterations / 1000;
+        if (games < 1)
+            games = 1;
+
+        long long actions = 0;
+        counters.start();
+        for (int g = 0; g < games; g++)
         {
-            isPaused = !isPaused;
+            actions += game.simulateGame((unsigned int)(g + 1), 2000);
         }
+        counters.stop();
+        counters.report("simulateGame (per action)", actions);
+        counters.report("simulateGame (per game)", games);
+    }
+}
+
+/* ============================================================
+ * PIPE AUTOMATION PROTOCOL
+ * ============================================================
+ *
+ * Bots and load tests drive the game with text commands on stdin, one
+ * per line, and read one response line per command on stdout:
+ *   new [seed]          deal a new game (default: the next seed)
+ *   select <row> <col>  select a pyramid card (row 0-6, col 0-row)
+ *   waste               select the top waste card
+ *   draw                draw from the stock (recycles an empty stock)
+ *   undo                take back the last command that changed the game
+ *   save                write the saved game
+ *   query               just report the state
+ *   quit
+ * Responses are "ok <state>" (see describeState) or "error <reason>".
+ * Lines longer than PIPE_LINE_MAX are rejected. The session ends at quit
+ * or at the end of stdin. Log messages go to stderr, so stdout carries
+ * only responses.
+ *
+ * --pipe runs without a window, as fast as commands arrive; deals are
+ * seeded from 1. --pipe --window plays the same commands in the normal
+ * game window, read by PipeCommandReader between frames.
+ * ============================================================ */
+
+int runPipeSession()
+{
+    PyramidSolitaire game(true);
+    game.useSeedSequence(1);
 
-        // Handle paused state
-        if (isPaused)
+    string line;
+    string response;
+    while (getline(cin, line))
+    {
+        bool more = game.runPipeCommand(line.c_str(), response);
+        fputs(response.c_str(), stdout);
+        fputc('\n', stdout);
+        fflush(stdout);
+        if (!more)
+            break;
+    }
+    return 0;
+}
+
+// Reads stdin lines on a background thread so the game loop never blocks
+// on it. Lines wait in a fixed ring until the loop takes them with pop();
+// the reader waits when the ring is full. A slot keeps one character past
+// PIPE_LINE_MAX, so an over-long line still arrives too long to run.
+class PipeCommandReader
+{
+public:
+    static const int LINE_LENGTH = PIPE_LINE_MAX + 2;
+
+private:
+    static const int CAPACITY = 64;
+
+    char lines[CAPACITY][LINE_LENGTH];
+    int head;
+    int count;
+    bool closed;
+    bool stopping;
+    mutex lock;
+    condition_variable space;
+
+    void run()
+    {
+        string line;
+        while (getline(cin, line))
         {
-            if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON))
-            {
-                Vector2 mousePos = GetMousePosition();
-                int sw = GetScreenWidth();
-                int sh = GetScreenHeight();
-                Rectangle restartBtn = { (float)(sw - 150), (float)(sh - 60), 120, 50 };
-                if (CheckCollisionPointRec(mousePos, restartBtn))
-                {
-                    initGame();
-                    return;
-                }
-            }
-            return;
+            unique_lock<mutex> guard(lock);
+            space.wait(guard, [this] { return stopping || count < CAPACITY; });
+            if (stopping)
+                return;
+            char* slot = lines[(head + count) % CAPACITY];
+            strncpy(slot, line.c_str(), LINE_LENGTH - 1);
+            slot[LINE_LENGTH - 1] = '\0';
+            count++;
+            // Wakes the main loop if --idle has it waiting for input
+            glfwPostEmptyEvent();
         }
 
-        // Update game time and check lose condition
-        if (!gameWon && !gameLost)
-        {
-            gameTime += deltaTime;
+        lock_guard<mutex> guard(lock);
+        closed = true;
+    }
 
-            static float checkTimer = 0.0f;
-            checkTimer += deltaTime;
-            if (checkTimer >= 0.5f)
-            {
-                checkLoseCondition();
-                checkTimer = 0.0f;
-            }
-        }
+public:
+    PipeCommandReader() : head(0), count(0), closed(false), stopping(false)
+    {
+    }
 
-        // Handle mouse clicks
-        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON))
-        {
-            Vector2 mousePos = GetMousePosition();
+    // The thread is detached: it may be blocked reading stdin at exit
+    void start()
+    {
+        thread(&PipeCommandReader::run, this).detach();
+    }
 
-            int sw = GetScreenWidth();
-            int sh = GetScreenHeight();
-            Rectangle restartBtn = { (float)(sw - 150), (float)(sh - 60), 120, 50 };
-            if (CheckCollisionPointRec(mousePos, restartBtn))
-            {
-                initGame();
-                return;
-            }
+    // Releases a reader waiting for ring space; it drops its line and
+    // ends. Must be called before exit, since destroying the condition
+    // variable under a waiting thread never returns.
+    void stop()
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+        space.notify_all();
+    }
 
-            handleMouseClick((int)mousePos.x, (int)mousePos.y);
-        }
+    bool pop(char* line)
+    {
+        lock_guard<mutex> guard(lock);
+        if (count == 0)
+            return false;
+        strcpy(line, lines[head]);
+        head = (head + 1) % CAPACITY;
+        count--;
+        space.notify_one();
+        return true;
+    }
+
+    // stdin has ended and every line has been taken
+    bool isFinished()
+    {
+        lock_guard<mutex> guard(lock);
+        return closed && count == 0;
     }
 };
 
-int main()
+int main(int argc, char* argv[])
 {
+    // Command line modes (no window):
+    //   --solver-bench [corpus] [results.csv] [repeats]
+    if (argc > 1 && strcmp(argv[1], "--solver-bench") == 0)
+    {
+        const char* corpusPath = (argc > 2) ? argv[2] : "solver_corpus.txt";
+        const char* resultsPath = (argc > 3) ? argv[3] : NULL;
+        int repeats = (argc > 4) ? atoi(argv[4]) : 3;
+        if (repeats < 1)
+            repeats = 1;
+        int failures = runSolverBenchmark(corpusPath, resultsPath, repeats);
+        return (failures == 0) ? 0 : 1;
+    }
+
+    //   --perf-bench [iterations]
+    if (argc > 1 && strcmp(argv[1], "--perf-bench") == 0)
+    {
+        int iterations = (argc > 2) ? atoi(argv[2]) : 100000;
+        if (iterations < 1)
+            iterations = 1;
+        runPerfBenchmark(iterations);
+        return 0;
+    }
+
+    //   --mem-report [games]
+    if (argc > 1 && strcmp(argv[1], "--mem-report") == 0)
+    {
+        int games = (argc > 2) ? atoi(argv[2]) : 10000;
+        if (games < 1)
+            games = 1;
+        runMemoryReport(games);
+        return 0;
+    }
+
+    //   --build-atlas
+    if (argc > 1 && strcmp(argv[1], "--build-atlas") == 0)
+        return buildCardAtlas(ATLAS_IMAGE_PATH, ATLAS_REGIONS_PATH);
+
+    //   --pack-assets [file]
+    if (argc > 1 && strcmp(argv[1], "--pack-assets") == 0)
+        return packAssets((argc > 2) ? argv[2] : ASSET_PACK_PATH);
+
+    //   --replay <file> [repeats]
+    if (argc > 2 && strcmp(argv[1], "--replay") == 0)
+    {
+        int repeats = (argc > 3) ? atoi(argv[3]) : 1;
+        if (repeats < 1)
+            repeats = 1;
+        return runInputReplay(argv[2], repeats);
+    }
+
+    //   --pipe [--window]
+    bool pipeCommands = false;
+    if (argc > 1 && strcmp(argv[1], "--pipe") == 0)
+    {
+        // Keep stdout for protocol responses
+        streambuf* consoleBuffer = cout.rdbuf(cerr.rdbuf());
+        if (argc < 3 || strcmp(argv[2], "--window") != 0)
+        {
+            int result = runPipeSession();
+            cout.rdbuf(consoleBuffer);
+            return result;
+        }
+        pipeCommands = true;
+        SetTraceLogLevel(LOG_WARNING);
+    }
+
+    // Game options:
+    //   --startup-report <file>   also write the startup timeline to a file
+    //   --record <file>           record input for --replay (seeded deals)
+    //   --texture-budget <KB>     card face texture memory limit
+    //   --idle                    redraw only when the screen changes
+    //   --draw-stats              print draw calls per frame at exit
+    //   --fps <n>                 frame rate cap (0 = none); game speed is unaffected
+    const char* startupReportPath = NULL;
+    const char* recordPath = NULL;
+    long long textureBudgetKB = 0;
+    bool idleRendering = false;
+    bool drawStats = false;
+    int targetFps = 60;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--startup-report") == 0 && i + 1 < argc)
+            startupReportPath = argv[++i];
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+            textureBudgetKB = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--idle") == 0)
+            idleRendering = true;
+        else if (strcmp(argv[i], "--draw-stats") == 0)
+            drawStats = true;
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+            targetFps = atoi(argv[++i]);
+    }
+
     const int screenWidth = 1400;
     const int screenHeight = 950;
 
+    startupTimeline.mark("before main");
+    // The game draws on a fixed canvas scaled to the window, so any size works
+    SetConfigFlags(FLAG_WINDOW_RESIZABLE);
     InitWindow(screenWidth, screenHeight, "Pyramid Solitaire with BST");
-    SetTargetFPS(60);
+    SetWindowMinSize(screenWidth / 4, screenHeight / 4);
+    SetTargetFPS(targetFps);
+    startupTimeline.mark("InitWindow");
 
     PyramidSolitaire game;
-
-    while (!WindowShouldClose())
+    if (recordPath)
+        game.startRecording(recordPath);
+    game.setTextureBudget(textureBudgetKB * 1024);
+    if (drawStats)
+        game.enableDrawStats();
+
+    // Static: the detached reader thread may outlive main()
+    static PipeCommandReader pipeReader;
+    if (pipeCommands)
+        pipeReader.start();
+    bool quit = false;
+
+    // Frame times are measured here rather than with GetFrameTime(),
+    // because idle iterations never reach EndDrawing()
+    double lastFrameTime = GetTime();
+    double lastRenderTime = 0.0;
+    int windowWidth = GetScreenWidth();
+    int windowHeight = GetScreenHeight();
+    while (!quit && !game.shouldQuit() && !WindowShouldClose())
     {
-        game.update(GetFrameTime());
+        if (pipeCommands)
+        {
+            char line[PipeCommandReader::LINE_LENGTH];
+            string response;
+            while (!quit && pipeReader.pop(line))
+            {
+                quit = !game.runPipeCommand(line, response);
+                fputs(response.c_str(), stdout);
+                fputc('\n', stdout);
+                fflush(stdout);
+            }
+            if (pipeReader.isFinished())
+                quit = true;
+        }
+
+        double now = GetTime();
+        game.update((float)(now - lastFrameTime));
+        lastFrameTime = now;
+
+        // Sizes are compared rather than asking IsWindowResized(): the
+        // idle wait below handles window events before raylib's poll
+        if (GetScreenWidth() != windowWidth || GetScreenHeight() != windowHeight)
+        {
+            windowWidth = GetScreenWidth();
+            windowHeight = GetScreenHeight();
+            game.requestRedraw();
+        }
+
+        // In idle mode an unchanged screen is not redrawn; a redraw at
+        // least once a second covers anything the flags miss
+        if (idleRendering && !game.needsRedraw() && now - lastRenderTime < 1.0)
+        {
+            // Sleep until input arrives (the GLFW callbacks queue it) or the
+            // clock has something to show; EndDrawing() would not wait
+            double wait = game.idleWaitSeconds();
+            if (wait > 1.0 - (now - lastRenderTime))
+                wait = 1.0 - (now - lastRenderTime);
+            glfwWaitEventsTimeout(wait);
+            PollInputEvents();
+            continue;
+        }
+
         game.render();
+        lastRenderTime = now;
+
+        if (!startupTimeline.isReported())
+        {
+            startupTimeline.mark("first frame");
+            startupTimeline.report(startupReportPath);
+        }
     }
 
+    if (pipeCommands)
+        pipeReader.stop();
     CloseWindow();
     return 0;
-}
\ No newline at end of file
+}
@@ -3,6 +3,15 @@
 #include <ctime>
 #include <fstream>
 #include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
@@ -247,6 +256,14 @@ public:
     }
 };
 
+// Heap block size for a request, as glibc malloc rounds it
+// (8-byte header, 16-byte alignment, 32-byte minimum)
+long long heapBlockBytes(long long requested)
+{
+    long long block = (requested + 8 + 15) / 16 * 16;
+    return (block < 32) ? 32 : block;
+}
+
 // Game class
 class PyramidSolitaire
 {
@@ -302,6 +319,10 @@ private:
     Sound stockDrawSound;
     float soundVolume;
 
+    // Headless games (memory report) have no window, audio or textures
+    // and never touch the score/save files.
+    bool headless;
+
     struct SaveData
     {
         int score;
@@ -324,8 +345,10 @@ private:
     };
 
 public:
-    PyramidSolitaire()
+    PyramidSolitaire(bool runHeadless = false)
     {
+        headless = runHeadless;
+
         for (int i = 0; i < 7; i++)
         {
             pyramidRows[i] = nullptr;
@@ -348,18 +371,33 @@ public:
         currentState = MAIN_MENU;
         isPaused = false;
         highScoreCount = 0;
+        soundVolume = 0.7f;
+        stockRect = {0, 0, 0, 0};
+
+        if (headless)
+        {
+            cardSelectSound = {0};
+            cardMatchSound = {0};
+            cardMismatchSound = {0};
+            stockDrawSound = {0};
+            return;
+        }
 
         loadHighScores();
         InitAudioDevice();
 
-        soundVolume = 0.7f;
         loadAllSounds();
         loadCardTextures();
-        stockRect = {0, 0, 0, 0};
     }
 
     ~PyramidSolitaire()
     {
+        if (headless)
+        {
+            clearPyramid();
+            return;
+        }
+
         // Save current score when exiting game (only if in active game)
         if (currentState == PLAYING && !gameWon && !gameLost && score > 0)
         {
@@ -527,6 +565,9 @@ public:
 
     void saveCurrentGameScore()
     {
+        if (headless)
+            return;
+
         // If this is a new game, add a new score entry
         if (isNewGame)
         {
@@ -1087,6 +1128,47 @@ public:
         saveCurrentGameScore();
         deleteSaveGame();
     }
+    // Bytes held by one live game, split by representation
+    void printMemoryFootprint()
+    {
+        long long pyramidNodes = 0;
+        for (int row = 0; row < 7; row++)
+        {
+            PyramidNode *current = pyramidRows[row];
+            while (current)
+            {
+                pyramidNodes++;
+                current = current->nextInRow;
+            }
+        }
+
+        long long pyramidNodeBytes = sizeof(PyramidNode);
+        long long deckNodeBytes = sizeof(ListNode<Card>);
+        long long pileNodeBytes = sizeof(ListNode<Card *>);
+        long long deckNodes = deck.getSize();
+        long long pileNodes = stock.getSize() + stockBackup.getSize() + wasteHistory.getSize();
+
+        long long heapBytes = pyramidNodes * heapBlockBytes(pyramidNodeBytes)
+            + deckNodes * heapBlockBytes(deckNodeBytes)
+            + pileNodes * heapBlockBytes(pileNodeBytes);
+
+        cout << "LinkedList version, bytes per live game:" << endl;
+        cout << "  Card[52]                  " << sizeof(allCards) << endl;
+        cout << "  PyramidNode graph         " << pyramidNodes << " x " << pyramidNodeBytes << " = "
+             << pyramidNodes * pyramidNodeBytes << " (" << pyramidNodes * heapBlockBytes(pyramidNodeBytes)
+             << " with malloc overhead)" << endl;
+        cout << "  deck nodes (LinkedList<Card>) " << deckNodes << " x " << deckNodeBytes << " = "
+             << deckNodes * deckNodeBytes << " (" << deckNodes * heapBlockBytes(deckNodeBytes)
+             << " with malloc overhead)" << endl;
+        cout << "  pile nodes (LinkedList<Card *>) " << pileNodes << " x " << pileNodeBytes << " = "
+             << pileNodes * pileNodeBytes << " (" << pileNodes * heapBlockBytes(pileNodeBytes)
+             << " with malloc overhead)" << endl;
+        cout << "  PyramidSolitaire object   " << sizeof(PyramidSolitaire)
+             << " (includes Card[52], excludes heap nodes)" << endl;
+        cout << "  total                     " << sizeof(PyramidSolitaire) + heapBytes << endl;
+        cout << "  SaveData                  " << sizeof(SaveData) << endl;
+    }
+
     void handleMouseClick(int mouseX, int mouseY)
     {
         if (gameWon || gameLost)
@@ -1633,6 +1715,9 @@ public:
 
     void saveGame()
     {
+        if (headless)
+            return;
+
         SaveData data = {};
 
         data.score = score;
@@ -1879,6 +1964,9 @@ public:
 
     void deleteSaveGame()
     {
+        if (headless)
+            return;
+
         if (remove(SAVE_FILE) == 0)
         {
             cout << "Save file deleted." << endl;
@@ -1886,8 +1974,301 @@ public:
     }
 };
 
-int main()
+/* ============================================================
+ * HARDWARE PERFORMANCE COUNTERS (benchmark harness)
+ * ============================================================
+ * Linux only: uses perf_event_open to count cycles, instructions,
+ * L1 data cache read misses, last-level cache misses and branch misses
+ * for the current thread (user space only). On other platforms, or when
+ * the kernel refuses access (see /proc/sys/kernel/perf_event_paranoid),
+ * the counters report as unavailable and only wall time is printed.
+ * ============================================================ */
+
+enum PerfCounterId
 {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTER_COUNT
+};
+
+class PerfCounters
+{
+private:
+    int fds[PERF_COUNTER_COUNT];
+    long long values[PERF_COUNTER_COUNT];
+    chrono::steady_clock::time_point startTime;
+    double seconds;
+
+#ifdef __linux__
+    static int openCounter(unsigned int type, unsigned long long config)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+
+public:
+    PerfCounters()
+    {
+        seconds = 0.0;
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        {
+            fds[i] = -1;
+            values[i] = -1;
+        }
+
+#ifdef __linux__
+        fds[PERF_CYCLES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        fds[PERF_INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        fds[PERF_L1D_MISSES] = openCounter(PERF_TYPE_HW_CACHE,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        fds[PERF_LLC_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        fds[PERF_BRANCH_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+    }
+
+    ~PerfCounters()
+    {
+#ifdef __linux__
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        {
+            if (fds[i] >= 0)
+                close(fds[i]);
+        }
+#endif
+    }
+
+    bool isAvailable()
+    {
+        return fds[PERF_CYCLES] >= 0;
+    }
+
+    // Resets the counters and starts counting
+    void start()
+    {
+        seconds = 0.0;
+#ifdef __linux__
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        {
+            if (fds[i] >= 0)
+                ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+        }
+#endif
+        resume();
+    }
+
+    // pause()/resume() exclude setup work (e.g. refilling a list) between
+    // measured sections; the counts keep accumulating until stop()
+    void pause()
+    {
+#ifdef __linux__
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        {
+            if (fds[i] >= 0)
+                ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+#endif
+        seconds += chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    }
+
+    void resume()
+    {
+        startTime = chrono::steady_clock::now();
+#ifdef __linux__
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        {
+            if (fds[i] >= 0)
+                ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    void stop()
+    {
+        pause();
+#ifdef __linux__
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        {
+            values[i] = -1;
+            long long count = 0;
+            if (fds[i] >= 0 && read(fds[i], &count, sizeof(count)) == sizeof(count))
+                values[i] = count;
+        }
+#endif
+    }
+
+    // Prints one line with every counter divided by the number of operations
+    void report(const char *name, long long operations)
+    {
+        if (operations <= 0)
+            operations = 1;
+
+        const char *labels[PERF_COUNTER_COUNT] = { "cycles", "instr", "L1d-miss", "LLC-miss", "br-miss" };
+
+        cout << TextFormat("%-28s %10.1f ns/op", name, seconds * 1e9 / operations);
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        {
+            if (values[i] >= 0)
+                cout << TextFormat("  %s %.2f", labels[i], (double)values[i] / operations);
+            else
+                cout << "  " << labels[i] << " n/a";
+        }
+        if (values[PERF_CYCLES] > 0 && values[PERF_INSTRUCTIONS] >= 0)
+            cout << TextFormat("  IPC %.2f", (double)values[PERF_INSTRUCTIONS] / values[PERF_CYCLES]);
+        cout << endl;
+    }
+};
+
+/* ============================================================
+ * MEMORY FOOTPRINT REPORT (--mem-report)
+ * ============================================================
+ * Static sizes come from sizeof; heap sizes are node counts times node
+ * size, plus an estimate of the allocator's per-block overhead (glibc
+ * malloc, see heapBlockBytes). Resident
+ * set sizes are read from /proc/self/status and are Linux only.
+ * ============================================================ */
+
+// field = "VmRSS:" (current) or "VmHWM:" (peak); returns KB, -1 if unknown
+long long readProcessMemoryKB(const char *field)
+{
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line))
+    {
+        if (line.compare(0, strlen(field), field) == 0)
+            return atoll(line.c_str() + strlen(field));
+    }
+    return -1;
+}
+
+void runMemoryReport(int games)
+{
+    {
+        PyramidSolitaire sample(true);
+        sample.initGame();
+        sample.printMemoryFootprint();
+    }
+
+    long long baselineKB = readProcessMemoryKB("VmRSS:");
+
+    PyramidSolitaire **liveGames = new PyramidSolitaire *[games];
+    for (int i = 0; i < games; i++)
+    {
+        liveGames[i] = new PyramidSolitaire(true);
+        liveGames[i]->initGame();
+    }
+
+    long long peakKB = readProcessMemoryKB("VmHWM:");
+    long long liveKB = readProcessMemoryKB("VmRSS:");
+
+    cout << endl << games << " concurrent in-memory games:" << endl;
+    if (baselineKB < 0 || peakKB < 0)
+    {
+        cout << "  RSS not available on this platform" << endl;
+    }
+    else
+    {
+        double perGameBytes = (liveKB - baselineKB) * 1024.0 / games;
+        cout << "  RSS before " << baselineKB << " KB, with games " << liveKB
+            << " KB, peak " << peakKB << " KB" << endl;
+        cout << "  measured " << (long long)perGameBytes << " bytes per game";
+        if (perGameBytes > 0)
+            cout << ", about " << (long long)(1073741824.0 / perGameBytes) << " games per GB";
+        cout << endl;
+    }
+
+    for (int i = 0; i < games; i++)
+    {
+        delete liveGames[i];
+    }
+    delete[] liveGames;
+}
+
+// LinkedList<T>::popBack benchmark with hardware counters (--perf-bench)
+void runPerfBenchmark(int iterations)
+{
+    PerfCounters counters;
+    if (!counters.isAvailable())
+        cout << "Hardware counters unavailable, reporting wall time only" << endl;
+
+    // Empty a 24-card stock from the back; refilling is not counted
+    Card cards[24];
+    for (int i = 0; i < 24; i++)
+    {
+        cards[i] = Card(i % 13 + 1, i / 13);
+    }
+
+    // Stocks are filled a batch at a time outside the counted region, so
+    // the counters are paused once per batch rather than once per 24 pops
+    const int BATCH = 4096;
+    LinkedList<Card *> *stocks = new LinkedList<Card *>[BATCH];
+    long long checksum = 0;
+    int filled = 0;
+    for (int done = 0; done < iterations; done += filled)
+    {
+        if (done > 0)
+            counters.pause();
+        filled = (iterations - done < BATCH) ? iterations - done : BATCH;
+        for (int s = 0; s < filled; s++)
+        {
+            for (int i = 0; i < 24; i++)
+            {
+                stocks[s].pushBack(&cards[i]);
+            }
+        }
+        if (done > 0)
+            counters.resume();
+        else
+            counters.start();
+
+        for (int s = 0; s < filled; s++)
+        {
+            while (!stocks[s].isEmpty())
+            {
+                checksum += stocks[s].popBack()->value;
+            }
+        }
+    }
+    counters.stop();
+    delete[] stocks;
+    counters.report("LinkedList<Card *>::popBack", (long long)iterations * 24);
+
+    if (checksum == 0)
+        cout << "  unexpected empty list" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    // Command line modes (no window):
+    //   --perf-bench [iterations]
+    if (argc > 1 && strcmp(argv[1], "--perf-bench") == 0)
+    {
+        int iterations = (argc > 2) ? atoi(argv[2]) : 100000;
+        if (iterations < 1)
+            iterations = 1;
+        runPerfBenchmark(iterations);
+        return 0;
+    }
+
+    //   --mem-report [games]
+    if (argc > 1 && strcmp(argv[1], "--mem-report") == 0)
+    {
+        int games = (argc > 2) ? atoi(argv[2]) : 10000;
+        if (games < 1)
+            games = 1;
+        runMemoryReport(games);
+        return 0;
+    }
     const int screenWidth = 1400;
     const int screenHeight = 950;
 